@@ -1,13 +1,73 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
+#include <new>
+#include <set>
 #include <algorithm>
 #include <iomanip>
 #include <limits>
 #include <cstdlib>
-#include <ctime>
 #include <memory>
+#include <cstdint>
+#include <cmath>
+#include <charconv>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include <functional>
+#include <random>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <type_traits>
+#include <sstream>
+#include <chrono>
+#include <cctype>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__)
+#include <csignal>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+// Hot-path latency histograms and counters; build with -DRAILWAY_METRICS=0
+// to compile the recording out entirely
+#ifndef RAILWAY_METRICS
+#define RAILWAY_METRICS 1
+#endif
 
 // Forward declarations for circular dependencies
 class Ticket;
@@ -17,14 +77,6 @@ class User;
 // UTILITY FUNCTIONS
 // =====================================================================
 
-// Clears the console screen
-void clearScreen() {
-#ifdef _WIN32
-    system("cls");
-#else
-    system("clear");
-#endif
-}
 
 // Pauses execution and waits for the user to press Enter
 void pressEnterToContinue() {
@@ -33,11 +85,466 @@ void pressEnterToContinue() {
     std::cin.get();
 }
 
+// Money is fixed point: a whole number of paise (1/100 rupee), so amounts
+// add up exactly and a total never drifts from the sum of its parts
+using Paise = std::int64_t;
+
+// An amount typed in rupees, to the nearest paisa
+inline Paise toPaise(double rupees) { return std::llround(rupees * 100); }
+
+/**
+ * @class OutputBuffer
+ * @brief Rendering target for screens and reports.
+ * Text accumulates in a reusable buffer and reaches the stream in a single
+ * write per flush, instead of a flush per line as with std::endl. Large
+ * reports are written out in kChunkBytes pieces so the buffer stays
+ * bounded. Integers and money amounts are formatted with std::to_chars
+ * rather than through iostream locale machinery.
+ */
+class OutputBuffer {
+public:
+    static constexpr std::size_t kChunkBytes = 1 << 16;
+
+    explicit OutputBuffer(std::ostream& out = std::cout) : sink(&out) {}
+    explicit OutputBuffer(std::ostream* out) : sink(out) {} // Null: text is only collected, never written
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer& operator<<(const std::string& text) { buffer += text; return *this; }
+    OutputBuffer& operator<<(const char* text) { buffer += text; return *this; }
+    OutputBuffer& operator<<(char c) { buffer += c; return *this; }
+    template <typename Int, typename = typename std::enable_if<std::is_integral<Int>::value>::type>
+    OutputBuffer& operator<<(Int value);
+
+    OutputBuffer& money(Paise amount);                     // In rupees, with two decimals
+    OutputBuffer& number(double value);                    // Shortest text that reads back exactly
+    OutputBuffer& left(const std::string& text, std::size_t width); // Padded like std::left + std::setw
+    template <typename Int, typename = typename std::enable_if<std::is_integral<Int>::value>::type>
+    OutputBuffer& left(Int value, std::size_t width);
+    OutputBuffer& zeroPadded(unsigned value, int width);
+    OutputBuffer& repeat(char c, std::size_t count) { buffer.append(count, c); return *this; }
+    OutputBuffer& line();                                  // Ends a line; writes out a full chunk
+    // Pads what was appended since start (a size() taken on the same line) to width
+    OutputBuffer& padFrom(std::size_t start, std::size_t width);
+
+    std::size_t size() const { return buffer.size(); }
+    void redirect(std::ostream& out) { flush(); sink = &out; }
+    std::string take() { std::string text; text.swap(buffer); return text; } // Pending text, unwritten
+    void moveTo(std::string& text);                        // Appends the pending text to text instead
+    void flush();
+
+private:
+    std::ostream* sink;
+    std::string buffer;
+};
+
+template <typename Int, typename>
+OutputBuffer& OutputBuffer::operator<<(Int value) {
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    buffer.append(digits, end);
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::money(Paise amount) {
+    // Magnitude taken unsigned, so the most negative amount prints too
+    std::uint64_t paise = static_cast<std::uint64_t>(amount);
+    if (amount < 0) {
+        buffer += '-';
+        paise = 0 - paise;
+    }
+    *this << paise / 100;
+    buffer += '.';
+    return zeroPadded(static_cast<unsigned>(paise % 100), 2);
+}
+
+OutputBuffer& OutputBuffer::number(double value) {
+    char digits[32];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    buffer.append(digits, end);
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::left(const std::string& text, std::size_t width) {
+    std::size_t start = buffer.size();
+    buffer += text;
+    return padFrom(start, width);
+}
+
+template <typename Int, typename>
+OutputBuffer& OutputBuffer::left(Int value, std::size_t width) {
+    std::size_t start = buffer.size();
+    *this << value;
+    return padFrom(start, width);
+}
+
+OutputBuffer& OutputBuffer::zeroPadded(unsigned value, int width) {
+    char digits[16];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    for (int missing = width - static_cast<int>(end - digits); missing > 0; --missing) buffer += '0';
+    buffer.append(digits, end);
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::line() {
+    buffer += '\n';
+    if (sink != nullptr && buffer.size() >= kChunkBytes) flush();
+    return *this;
+}
+
+void OutputBuffer::moveTo(std::string& text) {
+    if (text.empty()) {
+        text.swap(buffer);
+    } else {
+        text += buffer;
+        buffer.clear();
+    }
+}
+
+void OutputBuffer::flush() {
+    if (sink == nullptr || buffer.empty()) return;
+    sink->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    sink->flush();
+    buffer.clear(); // Keeps its capacity for the next screen
+}
+
+// Widths count bytes; like std::setw, overlong text is not cut
+OutputBuffer& OutputBuffer::padFrom(std::size_t start, std::size_t width) {
+    std::size_t written = buffer.size() - start;
+    if (written < width) buffer.append(width - written, ' ');
+    return *this;
+}
+
 // Prints a styled header for different sections of the UI
+void printHeader(OutputBuffer& out, const std::string& title) {
+    std::size_t indent = (80 + title.length()) / 2;
+    out.repeat('=', 80).line();
+    out.repeat(' ', indent > title.length() ? indent - title.length() : 0) << title;
+    out.line().repeat('=', 80).line();
+}
+
 void printHeader(const std::string& title) {
-    std::cout << std::string(80, '=') << std::endl;
-    std::cout << std::setw((80 + title.length()) / 2) << title << std::endl;
-    std::cout << std::string(80, '=') << std::endl;
+    OutputBuffer out;
+    printHeader(out, title);
+}
+
+/**
+ * @class Terminal
+ * @brief In-process screen control for the interactive menus.
+ * Screens are cleared with ANSI escape sequences, or through the console
+ * API on Windows consoles without VT support, so a redraw never spawns a
+ * shell. With differential redraw enabled, a menu stays pinned at the top
+ * of the screen while the output below it scrolls, and the next menu only
+ * rewrites the rows that changed. Output that is not a terminal gets the
+ * plain text and no control sequences.
+ */
+class Terminal {
+public:
+    static Terminal& instance();
+    ~Terminal();
+
+    void clear();                            // Blank screen, cursor at the top left
+    void present(const std::string& frame);  // Draws a menu at the top of the screen
+    void setDifferential(bool enabled) { differential = enabled; }
+
+private:
+    Terminal();
+    int rows() const;  // Window height, or 0 if unknown
+    void send(const std::string& text);
+    void unpin();
+
+    bool interactive = false;  // stdout is a terminal
+    bool ansi = false;         // ...that understands VT escape sequences
+    bool differential = false;
+    std::vector<std::string> shown;  // Rows of the pinned menu; empty when nothing is pinned
+};
+
+Terminal& Terminal::instance() {
+    static Terminal terminal;
+    return terminal;
+}
+
+Terminal::Terminal() {
+#ifdef _WIN32
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    interactive = GetConsoleMode(console, &mode) != 0;
+    ansi = interactive && SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING) != 0;
+#else
+    interactive = isatty(STDOUT_FILENO) != 0;
+    const char* term = std::getenv("TERM");
+    ansi = interactive && term != nullptr && std::strcmp(term, "dumb") != 0;
+#endif
+}
+
+// Gives the whole screen back to the shell, with the cursor where it was
+Terminal::~Terminal() {
+    unpin();
+}
+
+int Terminal::rows() const {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) return 0;
+    return info.srWindow.Bottom - info.srWindow.Top + 1;
+#else
+    winsize size{};
+    return ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 ? size.ws_row : 0;
+#endif
+}
+
+void Terminal::send(const std::string& text) {
+    std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+    std::cout.flush();
+}
+
+void Terminal::unpin() {
+    if (shown.empty()) return;
+    shown.clear();
+    send("\x1b" "7\x1b[r\x1b" "8"); // Setting margins homes the cursor, so save and restore it
+}
+
+void Terminal::clear() {
+    if (!interactive) return;
+    unpin();
+    if (ansi) {
+        send("\x1b[H\x1b[2J\x1b[3J"); // Home, erase screen, erase scrollback
+        return;
+    }
+#ifdef _WIN32
+    std::cout.flush();
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(console, &info)) return;
+    DWORD cells = static_cast<DWORD>(info.dwSize.X) * static_cast<DWORD>(info.dwSize.Y);
+    DWORD written = 0;
+    COORD home = {0, 0};
+    FillConsoleOutputCharacterA(console, ' ', cells, home, &written);
+    FillConsoleOutputAttribute(console, info.wAttributes, cells, home, &written);
+    SetConsoleCursorPosition(console, home);
+#endif
+}
+
+// The frame's last row is the prompt, which always ends up holding the
+// user's answer, so it is redrawn every time.
+void Terminal::present(const std::string& frame) {
+    std::vector<std::string> lines;
+    for (std::size_t start = 0;;) {
+        std::size_t end = frame.find('\n', start);
+        lines.push_back(frame.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    int height = rows();
+    int frameRows = static_cast<int>(lines.size());
+    // Pinning needs a few rows left over below the menu to scroll in
+    if (!ansi || !differential || height < frameRows + 3) {
+        clear();
+        send(frame);
+        return;
+    }
+
+    OutputBuffer out;
+    bool repaint = shown.empty();
+    if (repaint) out << "\x1b[H\x1b[2J\x1b[3J";
+    // Output scrolls only in the rows below the menu; this also homes the cursor
+    out << "\x1b[" << frameRows + 1 << ';' << height << 'r';
+    for (int row = 0; row + 1 < frameRows; ++row) {
+        if (!repaint && row < static_cast<int>(shown.size()) && shown[row] == lines[row]) continue;
+        out << "\x1b[" << row + 1 << ";1H" << lines[row] << "\x1b[K";
+    }
+    out << "\x1b[" << frameRows + 1 << ";1H\x1b[J";   // Erase what the last screen left below
+    out << "\x1b[" << frameRows << ";1H" << lines.back() << "\x1b[K";
+    out.flush();
+    shown = std::move(lines);
+}
+
+// Counters bumped from every core are split into stripes, one per group of
+// threads, so increments don't contend; readers sum the stripes
+constexpr std::size_t kCounterStripes = 16;
+
+inline std::size_t counterStripe() {
+    static std::atomic<std::size_t> nextStripe{0};
+    thread_local std::size_t stripe = nextStripe++ % kCounterStripes;
+    return stripe;
+}
+
+/**
+ * @class EpochDomain
+ * @brief Epoch-based reclamation for data that readers use without locks.
+ * A reader pins the current epoch while it reads. A writer that unlinks an
+ * object tags it with the epoch and frees it once the epoch has moved on
+ * twice, by which time every reader that could have reached it has left.
+ * The epoch only advances when no reader is still pinned in the previous
+ * one, so pins are counted per epoch parity, in stripes like the metrics
+ * counters. Neither side ever waits for the other; a long read only delays
+ * reclamation.
+ */
+class EpochDomain {
+public:
+    // Pins the epoch for its lifetime; nesting is fine
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain);
+        ~Guard() { pins->fetch_sub(1, std::memory_order_release); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        std::atomic<std::int64_t>* pins;
+    };
+
+    std::uint64_t current() const { return epoch.load(); } // The tag for an object just unlinked
+    bool tryAdvance(); // Moves the epoch on if the previous one has no readers left
+    bool reclaimable(std::uint64_t retiredAt) const { return epoch.load() >= retiredAt + 2; }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<std::int64_t> pins[2] = {}; // Readers pinned in even and odd epochs
+    };
+
+    std::array<Slot, kCounterStripes> slots;
+    std::atomic<std::uint64_t> epoch{0};
+};
+
+// A reader that saw the epoch move on between loading it and pinning it
+// backs off and pins the new one, so no pin lands in an epoch being drained
+EpochDomain::Guard::Guard(EpochDomain& domain) {
+    Slot& slot = domain.slots[counterStripe()];
+    for (;;) {
+        std::uint64_t seen = domain.epoch.load();
+        pins = &slot.pins[seen & 1];
+        pins->fetch_add(1);
+        if (domain.epoch.load() == seen) return;
+        pins->fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool EpochDomain::tryAdvance() {
+    std::uint64_t now = epoch.load();
+    for (const Slot& slot : slots) {
+        if (slot.pins[(now + 1) & 1].load() != 0) return false;
+    }
+    return epoch.compare_exchange_strong(now, now + 1);
+}
+
+/**
+ * @class RetireList
+ * @brief Objects unlinked from lock-free readers' view, each kept until
+ * its EpochDomain says no reader can still hold it. Reclaiming is done by
+ * the writers, when they next retire something, so there is no collector
+ * thread. Not synchronized; owners lock around it.
+ */
+template <typename T>
+class RetireList {
+public:
+    void retire(EpochDomain& domain, T item) { items.emplace_back(domain.current(), std::move(item)); }
+    void reclaim(EpochDomain& domain);
+    std::size_t size() const { return items.size(); }
+
+private:
+    std::deque<std::pair<std::uint64_t, T>> items; // Oldest first
+};
+
+template <typename T>
+void RetireList<T>::reclaim(EpochDomain& domain) {
+    if (items.empty()) return;
+    domain.tryAdvance();
+    while (!items.empty() && domain.reclaimable(items.front().first)) items.pop_front();
+}
+
+// Names a string held in the NamePool. Ids last only for the process, so
+// files keep the text and intern it again on load.
+using NameId = std::uint32_t;
+
+/**
+ * @class NamePool
+ * @brief Process-wide interning of the names the core records repeat:
+ * usernames, train names and stations. Each distinct string is stored once
+ * and named by a NameId, so a record holds four bytes rather than its own
+ * copy, and names compare as integers. Strings sit in chunks that never
+ * move, so text() takes no lock; the string-to-id map is split into
+ * stripes, each behind its own lock. Names are never removed. Id 0 is the
+ * empty string.
+ */
+class NamePool {
+public:
+    static constexpr NameId npos = std::numeric_limits<NameId>::max(); // Matches nothing stored
+    static NamePool& instance();
+
+    NameId intern(std::string_view name);     // Adds the name if it is new
+    NameId find(std::string_view name) const; // Never adds; npos if not interned
+    const std::string& text(NameId id) const {
+        return chunks[id >> kChunkBits].load(std::memory_order_acquire)->names[id & (kChunkSize - 1)];
+    }
+    std::size_t size() const { return count.load(); }
+
+private:
+    static constexpr std::size_t kChunkBits = 12;
+    static constexpr std::size_t kChunkSize = std::size_t(1) << kChunkBits; // Names per chunk
+    static constexpr std::size_t kMaxChunks = std::size_t(1) << 16;        // 2^28 names in all
+    static constexpr std::size_t kStripes = 64;
+
+    struct Chunk {
+        std::array<std::string, kChunkSize> names;
+    };
+
+    struct alignas(64) Stripe {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string_view, NameId> ids; // Views of the chunked strings
+    };
+
+    std::array<std::atomic<Chunk*>, kMaxChunks> chunks = {}; // Allocated as ids reach them
+    std::array<Stripe, kStripes> stripes;
+    std::atomic<NameId> count{0}; // The next id
+
+    NamePool() { intern(""); }
+    ~NamePool();
+    NamePool(const NamePool&) = delete;
+    NamePool& operator=(const NamePool&) = delete;
+
+    static std::size_t stripeOf(std::string_view name) { return std::hash<std::string_view>()(name) % kStripes; }
+};
+
+NamePool& NamePool::instance() {
+    static NamePool pool;
+    return pool;
+}
+
+NamePool::~NamePool() {
+    for (std::atomic<Chunk*>& chunk : chunks) delete chunk.load();
+}
+
+// The slot is filled before the id is published under the stripe lock, so
+// anyone handed the id can read its text without locking. Names in
+// different stripes may reach a new chunk together; one allocation wins.
+NameId NamePool::intern(std::string_view name) {
+    Stripe& stripe = stripes[stripeOf(name)];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.ids.find(name);
+    if (it != stripe.ids.end()) return it->second;
+
+    NameId id = count.fetch_add(1);
+    if (id >= kChunkSize * kMaxChunks) std::abort(); // Out of ids; no catalog comes near this
+    std::atomic<Chunk*>& slot = chunks[id >> kChunkBits];
+    Chunk* chunk = slot.load(std::memory_order_acquire);
+    if (!chunk) {
+        Chunk* fresh = new Chunk();
+        if (slot.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) chunk = fresh;
+        else delete fresh; // chunk now holds the winner's
+    }
+    std::string& stored = chunk->names[id & (kChunkSize - 1)];
+    stored.assign(name.data(), name.size());
+    stripe.ids.emplace(std::string_view(stored), id);
+    return id;
+}
+
+NameId NamePool::find(std::string_view name) const {
+    const Stripe& stripe = stripes[stripeOf(name)];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.ids.find(name);
+    return it == stripe.ids.end() ? npos : it->second;
 }
 
 // =====================================================================
@@ -54,9 +561,11 @@ public:
     std::string name;
     int age;
     char gender;
+    Paise fare = 0; // Charged for this passenger; set when the booking is priced
 
     void getDetails();
     void displayDetails() const;
+    void render(OutputBuffer& out) const;
 };
 
 void Passenger::getDetails() {
@@ -77,231 +586,6039 @@ void Passenger::getDetails() {
 }
 
 void Passenger::displayDetails() const {
-    std::cout << "      Name: " << std::left << std::setw(20) << name
-              << "Age: " << std::setw(5) << age
-              << "Gender: " << gender << std::endl;
+    OutputBuffer out;
+    render(out);
+}
+
+void Passenger::render(OutputBuffer& out) const {
+    out << "      Name: ";
+    out.left(name, 20) << "Age: ";
+    out.left(age, 5) << "Gender: " << gender;
+    out.repeat(' ', 7) << "Fare: Rs. ";
+    out.money(fare);
+    out.line();
 }
 
 /**
- * @class Train
- * @brief Represents a train, its route, schedule, and seat availability.
- * This class is fundamental to the system, managed by the Admin.
+ * @class InlineVector
+ * @brief Vector that keeps up to N elements inside the object itself.
+ * Only larger sizes touch the heap, so a small record costs no allocation
+ * of its own. Supports the subset of std::vector the booking records use.
  */
-class Train {
+template <typename T, std::size_t N>
+class InlineVector {
 public:
-    int trainNumber;
-    std::string trainName;
-    std::string source;
-    std::string destination;
-    double fare;
-    int totalSeats;
-    int availableSeats;
+    InlineVector() = default;
+    explicit InlineVector(std::size_t count) { resize(count); }
+    InlineVector(std::initializer_list<T> values);
+    InlineVector(const InlineVector& other);
+    InlineVector(InlineVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+    InlineVector& operator=(const InlineVector& other);
+    InlineVector& operator=(InlineVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+    ~InlineVector();
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+    T& operator[](std::size_t i) { return items[i]; }
+    const T& operator[](std::size_t i) const { return items[i]; }
+
+    void reserve(std::size_t wanted);
+    void resize(std::size_t wanted);
+    void push_back(const T& value);
+    void push_back(T&& value);
+    void clear();
 
-    Train(int num, std::string name, std::string src, std::string dest, double f, int seats);
+private:
+    alignas(T) unsigned char buffer[N * sizeof(T)];
+    T* items = reinterpret_cast<T*>(buffer);
+    std::size_t count = 0;
+    std::size_t capacity = N;
 
-    void display(bool showSeats = false) const;
-    bool bookSeats(int numSeats);
-    void cancelSeats(int numSeats);
+    bool isInline() const { return items == reinterpret_cast<const T*>(buffer); }
+    void takeFrom(InlineVector& other);
 };
 
-Train::Train(int num, std::string name, std::string src, std::string dest, double f, int seats)
-    : trainNumber(num), trainName(name), source(src), destination(dest), fare(f), 
-      totalSeats(seats), availableSeats(seats) {}
+template <typename T, std::size_t N>
+InlineVector<T, N>::InlineVector(std::initializer_list<T> values) {
+    reserve(values.size());
+    for (const T& value : values) push_back(value);
+}
+
+template <typename T, std::size_t N>
+InlineVector<T, N>::InlineVector(const InlineVector& other) {
+    reserve(other.count);
+    for (const T& value : other) push_back(value);
+}
+
+template <typename T, std::size_t N>
+InlineVector<T, N>::InlineVector(InlineVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+    takeFrom(other);
+}
 
-void Train::display(bool showSeats) const {
-    std::cout << std::left << std::setw(10) << trainNumber
-              << std::setw(25) << trainName
-              << std::setw(20) << source
-              << std::setw(20) << destination
-              << "Rs. " << std::setw(10) << std::fixed << std::setprecision(2) << fare;
-    if (showSeats) {
-        std::cout << "Seats: " << availableSeats << "/" << totalSeats;
+template <typename T, std::size_t N>
+InlineVector<T, N>& InlineVector<T, N>::operator=(const InlineVector& other) {
+    if (this != &other) {
+        clear();
+        reserve(other.count);
+        for (const T& value : other) push_back(value);
     }
-    std::cout << std::endl;
+    return *this;
 }
 
-bool Train::bookSeats(int numSeats) {
-    if (availableSeats >= numSeats) {
-        availableSeats -= numSeats;
-        return true;
+template <typename T, std::size_t N>
+InlineVector<T, N>& InlineVector<T, N>::operator=(InlineVector&& other)
+    noexcept(std::is_nothrow_move_constructible<T>::value) {
+    if (this != &other) {
+        clear();
+        if (!isInline()) ::operator delete(items);
+        items = reinterpret_cast<T*>(buffer);
+        capacity = N;
+        takeFrom(other);
     }
-    return false;
+    return *this;
 }
 
-void Train::cancelSeats(int numSeats) {
-    availableSeats += numSeats;
-    if (availableSeats > totalSeats) {
-        availableSeats = totalSeats; // Failsafe
+template <typename T, std::size_t N>
+InlineVector<T, N>::~InlineVector() {
+    clear();
+    if (!isInline()) ::operator delete(items);
+}
+
+// Steals a heap block outright; inline elements have to be moved across
+template <typename T, std::size_t N>
+void InlineVector<T, N>::takeFrom(InlineVector& other) {
+    if (!other.isInline()) {
+        items = other.items;
+        count = other.count;
+        capacity = other.capacity;
+        other.items = reinterpret_cast<T*>(other.buffer);
+        other.count = 0;
+        other.capacity = N;
+        return;
+    }
+    for (std::size_t i = 0; i < other.count; ++i) {
+        new (items + i) T(std::move(other.items[i]));
     }
+    count = other.count;
+    other.clear();
 }
 
-/**
- * @class Ticket
- * @brief Represents a booked ticket, connecting Passengers to a Train.
- * Stored in a map for efficient PNR-based searching.
- */
-class Ticket {
-public:
-    int pnr;
-    Train trainDetails;
-    std::vector<Passenger> passengers;
-    std::string bookedByUsername;
+template <typename T, std::size_t N>
+void InlineVector<T, N>::reserve(std::size_t wanted) {
+    if (wanted <= capacity) return;
+    T* grown = static_cast<T*>(::operator new(wanted * sizeof(T)));
+    for (std::size_t i = 0; i < count; ++i) {
+        new (grown + i) T(std::move(items[i]));
+        items[i].~T();
+    }
+    if (!isInline()) ::operator delete(items);
+    items = grown;
+    capacity = wanted;
+}
 
-    Ticket(int pnrNum, const Train& train, const std::string& username);
-    void addPassenger(const Passenger& passenger);
-    void display() const;
-};
+template <typename T, std::size_t N>
+void InlineVector<T, N>::resize(std::size_t wanted) {
+    reserve(wanted);
+    while (count > wanted) items[--count].~T();
+    for (; count < wanted; ++count) new (items + count) T();
+}
 
-Ticket::Ticket(int pnrNum, const Train& train, const std::string& username)
-    : pnr(pnrNum), trainDetails(train), bookedByUsername(username) {}
+template <typename T, std::size_t N>
+void InlineVector<T, N>::push_back(const T& value) {
+    T copy(value); // value may live in this vector, and growing would move it
+    push_back(std::move(copy));
+}
 
-void Ticket::addPassenger(const Passenger& passenger) {
-    passengers.push_back(passenger);
+template <typename T, std::size_t N>
+void InlineVector<T, N>::push_back(T&& value) {
+    if (count == capacity) reserve(std::max<std::size_t>(2 * capacity, 1));
+    new (items + count) T(std::move(value));
+    ++count;
 }
 
-void Ticket::display() const {
-    printHeader("TICKET DETAILS");
-    std::cout << "  PNR Number: " << pnr << std::endl;
-    std::cout << "  Booked By: " << bookedByUsername << std::endl;
-    std::cout << "  Train No:   " << trainDetails.trainNumber << " (" << trainDetails.trainName << ")" << std::endl;
-    std::cout << "  Route:      " << trainDetails.source << " -> " << trainDetails.destination << std::endl;
-    std::cout << "  Total Fare: Rs. " << std::fixed << std::setprecision(2) << trainDetails.fare * passengers.size() << std::endl;
-    std::cout << "\n--- Passengers (" << passengers.size() << ") ---" << std::endl;
-    for (const auto& p : passengers) {
-        p.displayDetails();
-    }
-    std::cout << std::string(80, '-') << std::endl;
+template <typename T, std::size_t N>
+void InlineVector<T, N>::clear() {
+    while (count > 0) items[--count].~T();
 }
 
-/**
- * @class User
- * @brief Represents a user account in the system.
- */
-class User {
-public:
-    std::string username;
-    std::string password;
-    bool isAdmin;
+// Passengers and seat numbers of one booking, stored inside the ticket.
+// Most bookings are for one or two travellers; inlining more Passengers
+// would bloat every ticket for the sake of rare large groups, while seat
+// numbers are small enough to inline a full six. Short passenger names stay
+// inline too, in std::string's small-string buffer.
+using PassengerList = InlineVector<Passenger, 2>;
+using SeatList = InlineVector<int, 6>;
 
-    User(std::string uname, std::string pwd, bool admin = false)
-        : username(uname), password(pwd), isAdmin(admin) {}
-};
+// Bit scans for the seat bitsets; builtins where the compiler has them
+inline int popcount64(std::uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(bits);
+#else
+    int count = 0;
+    for (; bits; bits &= bits - 1) ++count;
+    return count;
+#endif
+}
 
-// =====================================================================
-// RAILWAY MANAGEMENT SYSTEM
-// =====================================================================
+inline int lowestBit64(std::uint64_t bits) { // bits must be non-zero
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    for (; !(bits & 1); bits >>= 1) ++index;
+    return index;
+#endif
+}
+
+inline int highestBit64(std::uint64_t bits) { // bits must be non-zero
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(bits);
+#else
+    int index = 0;
+    while (bits >>= 1) ++index;
+    return index;
+#endif
+}
 
 /**
- * @class RailwayManager
- * @brief Main class to manage all railway operations and user interactions.
- * This class demonstrates Object-Oriented Programming principles by
- * encapsulating all data and functionalities.
+ * @class SeatInventory
+ * @brief Seat-by-segment occupancy of one train, as packed bitsets.
+ * A segment is the run between two consecutive stations. Bit s of word w
+ * for segment g is set when seat 64*w+s is sold on g, so a seat can be
+ * resold on legs that do not overlap. Each word of seats stores its
+ * segments contiguously; finding seats free over a leg is an OR across
+ * that leg's segments followed by a bit scan, 64 seats at a time.
+ * Not synchronized; Train guards it.
  */
-class RailwayManager {
-private:
-    std::vector<Train> trains;
-    std::map<int, Ticket> bookedTickets; // Map for efficient PNR-based searching.
-    std::map<std::string, User> users;   // Map for efficient username-based lookup.
-    User* currentUser = nullptr;
+class SeatInventory {
+public:
+    SeatInventory(int seats, int segments);
 
-    int generatePNR();
-    void seedData();
+    int seats() const { return seatCount; }
+    int segments() const { return segmentCount; }
+    int freeEndToEnd() const { return endToEndFree; } // Seats unsold on every segment
+    int freeSeats(int from, int to) const;            // Seats unsold over segments [from, to)
 
-    // Admin functionalities
-    void adminDashboard();
-    void addNewTrain();
-    void viewAllSystemTickets();
-    void modifyTrain();
+    // Picks count seats free over [from, to) and marks them sold; all or nothing
+    bool reserve(int count, int from, int to, SeatList& seatIds);
+    // Marks the given seats sold, e.g. on replay; fails if any is already taken.
+    // Seats beyond a reduced capacity are skipped, as in release.
+    bool claim(const SeatList& seatIds, int from, int to);
+    void release(const SeatList& seatIds, int from, int to);
+    void resize(int seats); // Keeps sales on surviving seats
 
-    // User functionalities
-    void userDashboard();
-    void viewAndSortTrains();
-    void bookTicket();
-    void viewMyTickets();
-    void cancelTicket();
+private:
+    int seatCount = 0;
+    int segmentCount;
+    int endToEndFree = 0;
+    std::size_t firstUntouched = 0;     // No word before this has a seat free end to end
+    std::vector<std::uint64_t> occupied; // [word * segmentCount + segment]
 
-public:
-    RailwayManager();
-    void run(); // Main application loop
-    bool login();
-    void registerUser();
+    std::size_t words() const { return (static_cast<std::size_t>(seatCount) + 63) / 64; }
+    std::uint64_t validBits(std::size_t word) const;
+    std::uint64_t soldMask(std::size_t word, int from, int to) const;
+    bool validLeg(int from, int to) const { return from >= 0 && from < to && to <= segmentCount; }
+    void mark(int seat, int from, int to, bool sold);
 };
 
-// --- Constructor & Initializer ---
-RailwayManager::RailwayManager() {
-    srand(static_cast<unsigned int>(time(nullptr)));
-    seedData();
+SeatInventory::SeatInventory(int seats, int segments) : segmentCount(std::max(1, segments)) {
+    resize(seats);
 }
 
-void RailwayManager::seedData() {
-    // Using STL vector to store train objects
-    trains.push_back(Train(12049, "Shatabdi Express", "New Delhi", "Kanpur", 1500.00, 100));
-    trains.push_back(Train(12951, "Rajdhani Express", "Mumbai", "New Delhi", 2870.00, 72));
-    trains.push_back(Train(22439, "Vande Bharat", "New Delhi", "Katra", 1800.50, 80));
-    trains.push_back(Train(12301, "Howrah Rajdhani", "Kolkata", "New Delhi", 2950.00, 72));
-    trains.push_back(Train(15027, "Maurya Express", "Gorakhpur", "Hatia", 750.00, 200));
+std::uint64_t SeatInventory::validBits(std::size_t word) const {
+    std::size_t remaining = static_cast<std::size_t>(seatCount) - word * 64;
+    return remaining >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << remaining) - 1;
+}
 
-    // Using STL map to store user objects
-    users.emplace("admin", User("admin", "admin123", true));
-    users.emplace("user", User("user", "user123", false));
+// Seats sold on any segment of [from, to) within one word
+std::uint64_t SeatInventory::soldMask(std::size_t word, int from, int to) const {
+    const std::uint64_t* segment = occupied.data() + word * segmentCount;
+    std::uint64_t sold = 0;
+    for (int g = from; g < to; ++g) sold |= segment[g];
+    return sold;
 }
 
-int RailwayManager::generatePNR() {
-    // Keep generating until a unique PNR is found
-    while (true) {
-        int pnr = 100000 + (rand() % 900000);
-        if (bookedTickets.find(pnr) == bookedTickets.end()) {
-            return pnr;
-        }
+int SeatInventory::freeSeats(int from, int to) const {
+    if (!validLeg(from, to)) return 0;
+    int free = 0;
+    for (std::size_t w = 0; w < words(); ++w) {
+        free += popcount64(~soldMask(w, from, to) & validBits(w));
     }
+    return free;
 }
 
-// --- Login and Registration ---
-bool RailwayManager::login() {
-    printHeader("LOGIN");
-    std::string username, password;
-    std::cout << "Enter username: ";
-    std::cin >> username;
-    std::cout << "Enter password: ";
-    std::cin >> password;
-
-    auto userIt = users.find(username);
-    if (userIt != users.end() && userIt->second.password == password) {
-        currentUser = &userIt->second;
-        std::cout << "\n✅ Login successful! Welcome, " << currentUser->username << "." << std::endl;
-        return true;
+void SeatInventory::mark(int seat, int from, int to, bool sold) {
+    std::size_t word = static_cast<std::size_t>(seat) / 64;
+    std::uint64_t bit = std::uint64_t(1) << (seat % 64);
+    bool wasFree = !(soldMask(word, 0, segmentCount) & bit);
+    std::uint64_t* segment = occupied.data() + word * segmentCount;
+    for (int g = from; g < to; ++g) {
+        segment[g] = sold ? segment[g] | bit : segment[g] & ~bit;
     }
-
-    std::cout << "\n❌ Invalid username or password." << std::endl;
-    return false;
+    bool isFree = !(soldMask(word, 0, segmentCount) & bit);
+    endToEndFree += static_cast<int>(isFree) - static_cast<int>(wasFree);
+    if (isFree) firstUntouched = std::min(firstUntouched, word);
 }
 
-void RailwayManager::registerUser() {
-    printHeader("REGISTER NEW USER");
-    std::string username, password;
-    std::cout << "Enter new username: ";
-    std::cin >> username;
+/*
+ * Seats already sold elsewhere on the route are preferred, so seats free
+ * end to end stay available for long journeys. A whole-route leg can only
+ * use untouched seats, and those are found from a low-water mark rather
+ * than by scanning from the first seat.
+ */
+bool SeatInventory::reserve(int count, int from, int to, SeatList& seatIds) {
+    seatIds.clear();
+    if (count <= 0 || !validLeg(from, to)) return false;
+    std::size_t needed = static_cast<std::size_t>(count);
 
-    if (users.count(username)) {
-        std::cout << "\n❌ Username already exists. Please try another." << std::endl;
-        return;
+    bool wholeRoute = from == 0 && to == segmentCount;
+    for (std::size_t w = 0; !wholeRoute && w < words() && seatIds.size() < needed; ++w) {
+        std::uint64_t untouched = ~soldMask(w, 0, segmentCount);
+        std::uint64_t candidates = ~soldMask(w, from, to) & ~untouched & validBits(w);
+        for (; candidates && seatIds.size() < needed; candidates &= candidates - 1) {
+            seatIds.push_back(static_cast<int>(w * 64) + lowestBit64(candidates));
+        }
+    }
+    std::size_t w = firstUntouched;
+    for (bool skipping = true; w < words() && seatIds.size() < needed; ++w) {
+        std::uint64_t candidates = ~soldMask(w, 0, segmentCount) & validBits(w);
+        if (skipping && !candidates) firstUntouched = w + 1;
+        skipping = skipping && !candidates;
+        for (; candidates && seatIds.size() < needed; candidates &= candidates - 1) {
+            seatIds.push_back(static_cast<int>(w * 64) + lowestBit64(candidates));
+        }
+    }
+    if (seatIds.size() < needed) {
+        seatIds.clear();
+        return false;
+    }
+    for (int seat : seatIds) mark(seat, from, to, true);
+    return true;
+}
+
+bool SeatInventory::claim(const SeatList& seatIds, int from, int to) {
+    if (!validLeg(from, to)) return false;
+    for (int seat : seatIds) {
+        if (seat < 0) return false;
+        std::size_t word = static_cast<std::size_t>(seat) / 64;
+        if (seat < seatCount && (soldMask(word, from, to) & (std::uint64_t(1) << (seat % 64)))) return false;
+    }
+    for (int seat : seatIds) {
+        if (seat < seatCount) mark(seat, from, to, true);
+    }
+    return true;
+}
+
+// Seats beyond a reduced capacity are ignored
+void SeatInventory::release(const SeatList& seatIds, int from, int to) {
+    if (!validLeg(from, to)) return;
+    for (int seat : seatIds) {
+        if (seat >= 0 && seat < seatCount) mark(seat, from, to, false);
+    }
+}
+
+void SeatInventory::resize(int seats) {
+    std::size_t oldWords = words();
+    seatCount = std::max(0, seats);
+    occupied.resize(words() * segmentCount, 0);
+    if (words() > 0) {
+        std::uint64_t* last = occupied.data() + (words() - 1) * segmentCount;
+        for (int g = 0; g < segmentCount; ++g) last[g] &= validBits(words() - 1);
+    }
+    endToEndFree = 0;
+    for (std::size_t w = 0; w < words(); ++w) {
+        endToEndFree += popcount64(~soldMask(w, 0, segmentCount) & validBits(w));
+    }
+    firstUntouched = oldWords > 0 ? std::min(firstUntouched, oldWords - 1) : 0;
+}
+
+// Date a train runs on, as days since 1970-01-01
+using RunDate = std::int32_t;
+
+// Today's date (UTC)
+RunDate currentDate() {
+    auto hours = std::chrono::duration_cast<std::chrono::hours>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return static_cast<RunDate>(hours / 24);
+}
+
+// Proleptic Gregorian calendar conversions, valid for any date the system will see
+RunDate daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return static_cast<RunDate>(era * 146097 + dayOfEra - 719468);
+}
+
+void civilFromDays(RunDate date, int& year, int& month, int& day) {
+    int z = date + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int dayOfEra = z - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int shifted = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    month = shifted + (shifted < 10 ? 3 : -9);
+    year = yearOfEra + era * 400 + (month <= 2);
+}
+
+std::string formatDate(RunDate date) {
+    int year, month, day;
+    civilFromDays(date, year, month, day);
+    char text[32];
+    std::snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, day);
+    return text;
+}
+
+// YYYY-MM-DD without going through snprintf, for bulk reports
+void renderDate(OutputBuffer& out, RunDate date) {
+    int year, month, day;
+    civilFromDays(date, year, month, day);
+    out.zeroPadded(static_cast<unsigned>(year), 4) << '-';
+    out.zeroPadded(static_cast<unsigned>(month), 2) << '-';
+    out.zeroPadded(static_cast<unsigned>(day), 2);
+}
+
+// Accepts YYYY-MM-DD; false for anything else, including impossible dates
+bool parseDate(const std::string& text, RunDate& date) {
+    int year, month, day;
+    char trailing;
+    if (std::sscanf(text.c_str(), "%4d-%2d-%2d%c", &year, &month, &day, &trailing) != 3) return false;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+    RunDate candidate = daysFromCivil(year, month, day);
+    if (formatDate(candidate) != text) return false; // e.g. 2025-02-30
+    date = candidate;
+    return true;
+}
+
+// Passenger Name Record number identifying a ticket
+using Pnr = std::uint64_t;
+
+// Unconfirmed bookings: RAC (reservation against cancellation) ranks ahead of the waitlist
+enum class WaitClass : std::uint8_t { Rac, Waitlist };
+
+/**
+ * @class WaitQueue
+ * @brief Bookings waiting for seats on one run of a train, in booking order.
+ * Both priority classes share one FIFO keyed by sequence number: the
+ * leading passengers, up to a tenth of the capacity, hold RAC and the rest
+ * are waitlisted. RAC is therefore a prefix that moves up by itself as
+ * entries ahead of it are confirmed or cancelled, and joining, leaving and
+ * confirming are each one O(log n) tree operation.
+ * Not synchronized; Train guards it.
+ */
+class WaitQueue {
+public:
+    struct Entry {
+        Pnr pnr;
+        int passengers;
+        int from; // Leg wanted, as station indexes
+        int to;
+    };
+    // An entry that has just been sold seats, for its ticket to be confirmed
+    struct Promotion {
+        Pnr pnr;
+        SeatList seats;
+        int from;
+        int to;
+    };
+    static constexpr int kRacShare = 10;          // One passenger in ten of the capacity may hold RAC
+    static constexpr std::size_t kScanLimit = 32; // Entries a pass may skip before it stops
+
+    bool promotionQueued = false; // A promotion pass is scheduled and has not started yet
+
+    int passengers() const { return queued; }
+    std::uint64_t take() { return nextSeq++; } // A place at the back, to be joined later
+    bool insert(std::uint64_t seq, const Entry& entry);
+    bool remove(std::uint64_t seq);
+    bool position(std::uint64_t seq, int capacity, WaitClass& waitClass, int& place) const;
+    void promote(SeatInventory& seats, std::vector<Promotion>& promoted);
+
+private:
+    std::map<std::uint64_t, Entry> entries;
+    std::uint64_t nextSeq = 1;
+    int queued = 0; // Passengers across all entries
+};
+
+// Also restores entries from disk, so later places are numbered after them
+bool WaitQueue::insert(std::uint64_t seq, const Entry& entry) {
+    nextSeq = std::max(nextSeq, seq + 1);
+    std::size_t before = entries.size();
+    entries.emplace_hint(entries.end(), seq, entry); // Usually the back
+    if (entries.size() == before) return false;
+    queued += entry.passengers;
+    return true;
+}
+
+bool WaitQueue::remove(std::uint64_t seq) {
+    auto it = entries.find(seq);
+    if (it == entries.end()) return false;
+    queued -= it->second.passengers;
+    entries.erase(it);
+    return true;
+}
+
+// Places count passengers, from 1, within the entry's class. Costs time in
+// proportion to the entries ahead, which the list's cap bounds.
+bool WaitQueue::position(std::uint64_t seq, int capacity, WaitClass& waitClass, int& place) const {
+    int racSeats = capacity / kRacShare;
+    int ahead = 0, racHeld = 0;
+    bool racOpen = true;
+    for (const auto& pair : entries) {
+        racOpen = racOpen && racHeld + pair.second.passengers <= racSeats;
+        if (pair.first == seq) {
+            waitClass = racOpen ? WaitClass::Rac : WaitClass::Waitlist;
+            place = racOpen ? racHeld + 1 : ahead - racHeld + 1;
+            return true;
+        }
+        if (racOpen) racHeld += pair.second.passengers;
+        ahead += pair.second.passengers;
+        if (pair.first > seq) break;
+    }
+    return false;
+}
+
+/*
+ * Sells seats to entries in queue order. An entry that doesn't fit keeps its
+ * place and is passed over, so a large party never holds up a smaller one
+ * behind it, but at most kScanLimit are passed over; a pass stays short
+ * however long the list is.
+ */
+void WaitQueue::promote(SeatInventory& seats, std::vector<Promotion>& promoted) {
+    std::size_t passed = 0;
+    for (auto it = entries.begin(); it != entries.end() && passed < kScanLimit;) {
+        const Entry& entry = it->second;
+        Promotion promotion{entry.pnr, {}, entry.from, entry.to};
+        if (!seats.reserve(entry.passengers, entry.from, entry.to, promotion.seats)) {
+            ++passed;
+            ++it;
+            continue;
+        }
+        queued -= entry.passengers;
+        promoted.push_back(std::move(promotion));
+        it = entries.erase(it);
+    }
+}
+
+// =====================================================================
+// FARES
+// =====================================================================
+
+// Booking quota. Tatkal is the late, premium quota: it pays a surcharge
+// and gets no concessions.
+enum class Quota : std::uint8_t { General, Tatkal };
+constexpr std::size_t kQuotas = 2;
+
+const char* quotaName(Quota quota) { return quota == Quota::Tatkal ? "Tatkal" : "General"; }
+
+/**
+ * @brief Pricing rules of one quota, fixed at compile time.
+ * FareEngine prices each quota with its own instantiation, so a rule that
+ * does not apply to a quota leaves no branch behind in its code. Rates are
+ * in basis points (hundredths of a percent).
+ */
+template <Quota Q> struct FareRules;
+
+template <> struct FareRules<Quota::General> {
+    static constexpr bool kConcessions = true; // By age and gender
+    static constexpr Paise kSurchargeBp = 0;
+    static constexpr Paise kMinSurcharge = 0;
+    static constexpr Paise kMaxSurcharge = 0;
+};
+
+// 30% of the leg's fare on top, but no less than Rs. 100 and no more than Rs. 400
+template <> struct FareRules<Quota::Tatkal> {
+    static constexpr bool kConcessions = false;
+    static constexpr Paise kSurchargeBp = 3000;
+    static constexpr Paise kMinSurcharge = 10000;
+    static constexpr Paise kMaxSurcharge = 40000;
+};
+
+/**
+ * @class FareTable
+ * @brief A train's fares by quota and distance, precomputed.
+ * Distance is counted in segments of the route, the only measure of it
+ * the catalog has: a leg over d of the route's n segments costs d/n of the
+ * train's fare, rounded up to the rupee, and the whole route costs exactly
+ * the fare. Each cell also carries its quota's surcharge, so a booking is
+ * priced from one cell with no division by the route length. Rebuilt
+ * whenever the fare changes.
+ */
+class FareTable {
+public:
+    struct Cell {
+        Paise fare;      // Before surge and concessions
+        Paise surcharge; // The quota's, added last
+    };
+
+    void build(Paise trainFare, int segments);
+    const Cell& at(Quota quota, int distance) const { // distance in [1, segments]
+        return cells[static_cast<std::size_t>(quota) * segments + static_cast<std::size_t>(distance) - 1];
+    }
+
+private:
+    std::size_t segments = 0;
+    std::vector<Cell> cells; // [quota][distance - 1]
+
+    template <Quota Q> static Paise surcharge(Paise fare);
+};
+
+template <Quota Q>
+Paise FareTable::surcharge(Paise fare) {
+    return std::clamp(fare * FareRules<Q>::kSurchargeBp / 10000, FareRules<Q>::kMinSurcharge,
+                      FareRules<Q>::kMaxSurcharge);
+}
+
+void FareTable::build(Paise trainFare, int routeSegments) {
+    segments = static_cast<std::size_t>(std::max(1, routeSegments));
+    cells.resize(kQuotas * segments);
+    Paise perSegments = static_cast<Paise>(segments) * 100; // Divisor that yields rupees
+    for (std::size_t d = 1; d <= segments; ++d) {
+        Paise share = trainFare * static_cast<Paise>(d);
+        Paise fare = std::min(trainFare, (share + perSegments - 1) / perSegments * 100);
+        if (d == segments || trainFare < 0) fare = trainFare;
+        cells[d - 1] = Cell{fare, surcharge<Quota::General>(fare)};
+        cells[segments + d - 1] = Cell{fare, surcharge<Quota::Tatkal>(fare)};
+    }
+}
+
+// Surge (flexi) pricing: the fare rises 10% for every tenth of the leg's
+// seats already sold, up to 50%. Indexed by tenths sold, 0 to 10.
+constexpr std::array<std::uint16_t, 11> surgeRates() {
+    std::array<std::uint16_t, 11> rates{};
+    for (int tenths = 0; tenths <= 10; ++tenths) {
+        rates[tenths] = static_cast<std::uint16_t>(10000 + 1000 * std::min(tenths, 5));
+    }
+    return rates;
+}
+
+// Share of the fare paid, by [woman][age]: children under 12 pay half,
+// women from 58 half and men and others from 60 three fifths
+constexpr std::array<std::array<std::uint16_t, 128>, 2> concessionRates() {
+    std::array<std::array<std::uint16_t, 128>, 2> rates{};
+    for (int woman = 0; woman < 2; ++woman) {
+        for (int age = 0; age < 128; ++age) {
+            std::uint16_t rate = 10000;
+            if (age < 12) rate = 5000;
+            else if (woman && age >= 58) rate = 5000;
+            else if (!woman && age >= 60) rate = 6000;
+            rates[woman][age] = rate;
+        }
+    }
+    return rates;
+}
+
+/**
+ * @class FareEngine
+ * @brief Prices each passenger of a booking from constant tables.
+ * A passenger pays the leg's FareTable cell, raised by the surge rate for
+ * how full the leg is and lowered by their concession, to the nearest
+ * paisa, plus the quota's surcharge. The rate tables are built at compile
+ * time and every step is integer arithmetic on paise, so a six-passenger
+ * booking costs a handful of loads and multiplies per passenger.
+ */
+class FareEngine {
+public:
+    static constexpr std::array<std::uint16_t, 11> kSurgeBp = surgeRates();
+    static constexpr std::array<std::array<std::uint16_t, 128>, 2> kConcessionBp = concessionRates();
+
+    // Tenths of capacity sold on a leg that had seatsFree left before the booking
+    static int soldTenths(int capacity, int seatsFree);
+    // Sets each passenger's fare for a leg over distance segments; tenths
+    // is the leg's soldTenths, or 0 to price without surge
+    static void price(const FareTable& table, Quota quota, int distance, int tenths, PassengerList& passengers);
+
+private:
+    template <Quota Q>
+    static void priceWith(const FareTable::Cell& cell, Paise surgeBp, PassengerList& passengers);
+};
+
+int FareEngine::soldTenths(int capacity, int seatsFree) {
+    if (capacity <= 0) return 10;
+    long long sold = static_cast<long long>(capacity) - std::max(0, seatsFree);
+    return static_cast<int>(std::clamp<long long>(sold * 10 / capacity, 0, 10));
+}
+
+void FareEngine::price(const FareTable& table, Quota quota, int distance, int tenths, PassengerList& passengers) {
+    const FareTable::Cell& cell = table.at(quota, distance);
+    Paise surgeBp = kSurgeBp[static_cast<std::size_t>(std::clamp(tenths, 0, 10))];
+    if (quota == Quota::Tatkal) {
+        priceWith<Quota::Tatkal>(cell, surgeBp, passengers);
+    } else {
+        priceWith<Quota::General>(cell, surgeBp, passengers);
+    }
+}
+
+// Rates multiply in basis points: a surged fare is in 1/10^4 paise, and
+// after a concession in 1/10^8
+template <Quota Q>
+void FareEngine::priceWith(const FareTable::Cell& cell, Paise surgeBp, PassengerList& passengers) {
+    Paise surged = cell.fare * surgeBp;
+    for (Passenger& passenger : passengers) {
+        if constexpr (FareRules<Q>::kConcessions) {
+            bool woman = passenger.gender == 'F' || passenger.gender == 'f';
+            Paise rate = kConcessionBp[woman][static_cast<std::size_t>(std::clamp(passenger.age, 0, 127))];
+            passenger.fare = (surged * rate + 50000000) / 100000000 + cell.surcharge;
+        } else {
+            passenger.fare = (surged + 5000) / 10000 + cell.surcharge;
+        }
+    }
+}
+
+/**
+ * @class Train
+ * @brief Represents a train, its route, schedule, and seat availability.
+ * This class is fundamental to the system, managed by the Admin.
+ * Each date the train runs on has its own SeatInventory, created on the
+ * first booking for that date and dropped once the date has passed, so
+ * memory follows the dates actually booked rather than the whole advance
+ * booking window. Seats are sold per leg behind a per-train lock, so
+ * bookings on different trains never contend. Bookings that find no seats
+ * can wait in the date's WaitQueue, under the same lock, until seats are
+ * returned.
+ */
+class Train {
+public:
+    int trainNumber;
+    NameId nameId;               // Names and stations are interned; the accessors below give the text
+    NameId sourceId;
+    NameId destinationId;
+    std::vector<NameId> stopIds; // Intermediate stations, in running order
+    std::atomic<Paise> fare;     // Whole route, General quota; atomic, like totalSeats, for listings
+                                 // that read without catalogMutex
+    std::atomic<int> totalSeats; // Capacity of every run
+    FareTable fareTable;         // Per leg and quota, from fare; read under catalogMutex
+
+    Train(int num, std::string name, std::string src, std::string dest, Paise f, int seats,
+          std::vector<std::string> via = {});
+    Train(const Train& other);
+    Train& operator=(const Train& other);
+
+    void display(int seatsFree = -1) const; // Shows seats when seatsFree >= 0
+    void render(OutputBuffer& out, int seatsFree = -1) const;
+    void setFare(Paise newFare); // Caller holds catalogMutex exclusively
+
+    const std::string& trainName() const { return NamePool::instance().text(nameId); }
+    const std::string& source() const { return NamePool::instance().text(sourceId); }
+    const std::string& destination() const { return NamePool::instance().text(destinationId); }
+
+    // Stations are numbered 0 (source) to segments() (destination); a leg
+    // [from, to) covers the segments between them
+    int segments() const { return static_cast<int>(stopIds.size()) + 1; }
+    int stationIndex(const std::string& station) const; // Case-insensitive; -1 if not on the route
+    NameId stationId(int index) const;
+    const std::string& stationName(int index) const { return NamePool::instance().text(stationId(index)); }
+
+    // One booking of a batched allocation pass
+    struct SeatRequest {
+        RunDate date;
+        int count;
+        int from;
+        int to;
+        bool joinWaitlist;
+        std::size_t slot;          // The caller's index for the booking
+        SeatList seats;            // Out: the seats sold, if any
+        std::uint64_t waitSeq = 0; // Out: else the waiting place taken, if it asked for one
+        int seatsLeft = 0;         // Out: seats free over the leg afterwards
+    };
+
+    // A ticket whose seats were cut by a capacity reduction
+    struct Reseat {
+        RunDate date;
+        int from;
+        int to;
+        SeatList seats;    // In: the ticket's seats; out: its new seats, if kept
+        bool kept = false; // Out: false if it could not be seated and gave up its seats
+    };
+
+    bool bookSeats(RunDate date, int numSeats, int from, int to, SeatList& seatIds);
+    void allocate(std::vector<SeatRequest>& requests); // In order, under one hold of the seat lock
+    bool claimSeats(RunDate date, const SeatList& seatIds, int from, int to);
+    // True if bookings are waiting on that date and no promotion was queued
+    // yet; the caller must then request one, which this marks as queued
+    bool cancelSeats(RunDate date, const SeatList& seatIds, int from, int to);
+    int seatsFree(RunDate date, int from, int to) const;
+    void setCapacity(int seats);
+    // After a capacity cut: keeps each ticket's surviving seats and finds the
+    // rest on its leg, in order, under one hold of the seat lock
+    void reseat(std::vector<Reseat>& tickets);
+    bool moveSeats(RunDate date, const SeatList& from, const SeatList& to, int boarding, int alighting); // On replay
+    std::size_t evictRunsBefore(RunDate date); // Returns how many runs were dropped
+    // Drops those dates' seats and waiting lists, and closes the dates to bookings
+    std::size_t cancelRuns(RunDate first, RunDate last);
+    bool runCancelled(RunDate date) const;
+    std::vector<std::pair<RunDate, RunDate>> cancelledRuns() const; // First and last date of each range
+    std::size_t activeRuns() const;
+    // Seat use summed over the runs in memory, for the occupancy gauges
+    struct Occupancy {
+        std::size_t runs = 0;
+        long long seatsHeld = 0; // Seats sold on at least one segment
+        long long seatCapacity = 0;
+        long long waitingPassengers = 0;
+    };
+    Occupancy occupancy() const;
+
+    // Waiting list. A booking takes a place in allocate, is published as a ticket,
+    // and only then joins, so a promotion never finds an entry without a ticket.
+    // True if seats are already free for the entry; the caller then requests a promotion
+    bool joinWaitlist(RunDate date, std::uint64_t seq, const WaitQueue::Entry& entry);
+    bool restoreWaiting(RunDate date, std::uint64_t seq, const WaitQueue::Entry& entry); // On load; no promotion
+    bool leaveWaitlist(RunDate date, std::uint64_t seq);
+    bool waitStatus(RunDate date, std::uint64_t seq, WaitClass& waitClass, int& place) const;
+    // Sells freed seats to waiting entries and clears the queued mark
+    void promoteWaiting(RunDate date, std::vector<WaitQueue::Promotion>& promoted);
+    std::vector<RunDate> queuePromotions(); // Dates needing a pass, each marked as queued
+
+private:
+    std::map<RunDate, SeatInventory> runs; // Only dates with sales
+    std::map<RunDate, WaitQueue> waiting;  // Only dates with bookings waiting
+    std::map<RunDate, RunDate> cancelled;  // Cancelled dates as disjoint ranges, first to last
+    mutable std::mutex seatMutex;
+
+    SeatInventory& run(RunDate date); // Caller holds seatMutex
+    std::uint64_t takeWaitPlace(RunDate date, int passengers); // Caller holds seatMutex; 0 if full
+    int waitingPassengers(RunDate date) const;                  // Caller holds seatMutex
+    bool cancelledOn(RunDate date) const;                       // Caller holds seatMutex
+};
+
+Train::Train(int num, std::string name, std::string src, std::string dest, Paise f, int seats,
+             std::vector<std::string> via)
+    : trainNumber(num), nameId(NamePool::instance().intern(name)), sourceId(NamePool::instance().intern(src)),
+      destinationId(NamePool::instance().intern(dest)), fare(f), totalSeats(seats) {
+    stopIds.reserve(via.size());
+    for (const std::string& stop : via) stopIds.push_back(NamePool::instance().intern(stop));
+    fareTable.build(f, segments());
+}
+
+// Copies take a point-in-time snapshot of the seat inventory and waiting lists
+Train::Train(const Train& other)
+    : trainNumber(other.trainNumber), nameId(other.nameId), sourceId(other.sourceId),
+      destinationId(other.destinationId), stopIds(other.stopIds), fare(other.fare.load()),
+      totalSeats(other.totalSeats.load()), fareTable(other.fareTable) {
+    std::lock_guard<std::mutex> lock(other.seatMutex);
+    runs = other.runs;
+    waiting = other.waiting;
+    cancelled = other.cancelled;
+}
+
+Train& Train::operator=(const Train& other) {
+    if (this == &other) return *this;
+    trainNumber = other.trainNumber;
+    nameId = other.nameId;
+    sourceId = other.sourceId;
+    destinationId = other.destinationId;
+    stopIds = other.stopIds;
+    fare.store(other.fare.load());
+    fareTable = other.fareTable;
+    std::scoped_lock lock(seatMutex, other.seatMutex);
+    runs = other.runs;
+    waiting = other.waiting;
+    cancelled = other.cancelled;
+    totalSeats.store(other.totalSeats.load());
+    return *this;
+}
+
+void Train::display(int seatsFree) const {
+    OutputBuffer out;
+    render(out, seatsFree);
+}
+
+void Train::render(OutputBuffer& out, int seatsFree) const {
+    out.left(trainNumber, 10).left(trainName(), 25).left(source(), 20).left(destination(), 20) << "Rs. ";
+    std::size_t start = out.size();
+    out.money(fare.load()).padFrom(start, 10);
+    if (seatsFree >= 0) {
+        out << "Seats: " << seatsFree << '/' << totalSeats.load();
+    }
+    out.line();
+}
+
+void Train::setFare(Paise newFare) {
+    fare.store(newFare);
+    fareTable.build(newFare, segments());
+}
+
+// A name spelled as interned matches on ids alone; only a differently
+// cased one falls back to comparing the text
+int Train::stationIndex(const std::string& station) const {
+    NameId exact = NamePool::instance().find(station);
+    for (int i = 0; exact != NamePool::npos && i <= segments(); ++i) {
+        if (stationId(i) == exact) return i;
+    }
+    auto same = [&station](const std::string& name) {
+        return name.size() == station.size() &&
+               std::equal(name.begin(), name.end(), station.begin(), [](unsigned char a, unsigned char b) {
+                   return std::tolower(a) == std::tolower(b);
+               });
+    };
+    for (int i = 0; i <= segments(); ++i) {
+        if (same(stationName(i))) return i;
+    }
+    return -1;
+}
+
+NameId Train::stationId(int index) const {
+    if (index <= 0) return sourceId;
+    return index >= segments() ? destinationId : stopIds[index - 1];
+}
+
+// All-or-nothing: either numSeats seats free over the leg on that date
+// are sold and returned in seatIds, or nothing changes. Concurrent callers
+// are serialized by seatMutex, so a seat is never sold twice on a segment.
+bool Train::bookSeats(RunDate date, int numSeats, int from, int to, SeatList& seatIds) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    return waitingPassengers(date) == 0 && run(date).reserve(numSeats, from, to, seatIds);
+}
+
+// A burst of bookings costs one lock acquisition rather than one per booking.
+// Freed seats belong to the waiting list, so while anyone waits for the run
+// a new booking queues behind them or is refused, and the seats left it
+// reports leave out those the waiting passengers are owed.
+void Train::allocate(std::vector<SeatRequest>& requests) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    for (SeatRequest& request : requests) {
+        SeatInventory& inventory = run(request.date);
+        int waitingAhead = waitingPassengers(request.date);
+        if ((waitingAhead > 0 || !inventory.reserve(request.count, request.from, request.to, request.seats)) &&
+            request.joinWaitlist) {
+            request.waitSeq = takeWaitPlace(request.date, request.count);
+        }
+        request.seatsLeft = std::max(0, inventory.freeSeats(request.from, request.to) - waitingAhead);
+    }
+}
+
+// Re-sells specific seats; used when replaying bookings from disk
+bool Train::claimSeats(RunDate date, const SeatList& seatIds, int from, int to) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    return run(date).claim(seatIds, from, to);
+}
+
+// A no-op once the date's run has been evicted
+bool Train::cancelSeats(RunDate date, const SeatList& seatIds, int from, int to) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    auto it = runs.find(date);
+    if (it == runs.end()) return false;
+    it->second.release(seatIds, from, to);
+    auto queue = waiting.find(date);
+    if (queue == waiting.end() || queue->second.passengers() == 0 || queue->second.promotionQueued) return false;
+    queue->second.promotionQueued = true;
+    return true;
+}
+
+int Train::seatsFree(RunDate date, int from, int to) const {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    if (cancelledOn(date)) return 0;
+    auto it = runs.find(date);
+    if (it != runs.end()) return it->second.freeSeats(from, to);
+    return from >= 0 && from < to && to <= segments() ? totalSeats.load() : 0; // Nothing sold yet
+}
+
+void Train::setCapacity(int seats) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    totalSeats.store(seats);
+    for (auto& entry : runs) entry.second.resize(seats);
+}
+
+void Train::reseat(std::vector<Reseat>& tickets) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    int capacity = totalSeats.load();
+    for (Reseat& ticket : tickets) {
+        SeatInventory& inventory = run(ticket.date);
+        SeatList surviving;
+        for (int seat : ticket.seats) {
+            if (seat < capacity) surviving.push_back(seat);
+        }
+        SeatList added;
+        int missing = static_cast<int>(ticket.seats.size() - surviving.size());
+        ticket.kept = missing == 0 || inventory.reserve(missing, ticket.from, ticket.to, added);
+        if (!ticket.kept) {
+            inventory.release(surviving, ticket.from, ticket.to);
+            continue;
+        }
+        for (int seat : added) surviving.push_back(seat);
+        ticket.seats = std::move(surviving);
+    }
+}
+
+// False, with nothing claimed, if any seat in to is already sold
+bool Train::moveSeats(RunDate date, const SeatList& from, const SeatList& to, int boarding, int alighting) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    SeatInventory& inventory = run(date);
+    inventory.release(from, boarding, alighting);
+    return inventory.claim(to, boarding, alighting);
+}
+
+// Ranges that overlap or touch the new one are merged into it
+std::size_t Train::cancelRuns(RunDate first, RunDate last) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    auto begin = runs.lower_bound(first), end = runs.upper_bound(last);
+    std::size_t dropped = static_cast<std::size_t>(std::distance(begin, end));
+    runs.erase(begin, end);
+    waiting.erase(waiting.lower_bound(first), waiting.upper_bound(last));
+    if (first > last) return dropped;
+    auto range = cancelled.upper_bound(first);
+    if (range != cancelled.begin() && std::prev(range)->second >= first - 1) {
+        --range;
+        first = range->first;
+    }
+    while (range != cancelled.end() && range->first - 1 <= last) {
+        last = std::max(last, range->second);
+        range = cancelled.erase(range);
+    }
+    cancelled.emplace(first, last);
+    return dropped;
+}
+
+bool Train::runCancelled(RunDate date) const {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    return cancelledOn(date);
+}
+
+bool Train::cancelledOn(RunDate date) const {
+    auto range = cancelled.upper_bound(date);
+    return range != cancelled.begin() && std::prev(range)->second >= date;
+}
+
+std::vector<std::pair<RunDate, RunDate>> Train::cancelledRuns() const {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    return std::vector<std::pair<RunDate, RunDate>>(cancelled.begin(), cancelled.end());
+}
+
+// Waiting lists of those dates go too, their tickets staying unconfirmed in
+// the history, and so do cancellations that have passed
+std::size_t Train::evictRunsBefore(RunDate date) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    auto end = runs.lower_bound(date);
+    std::size_t evicted = static_cast<std::size_t>(std::distance(runs.begin(), end));
+    runs.erase(runs.begin(), end);
+    waiting.erase(waiting.begin(), waiting.lower_bound(date));
+    while (!cancelled.empty() && cancelled.begin()->second < date) cancelled.erase(cancelled.begin());
+    return evicted;
+}
+
+std::size_t Train::activeRuns() const {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    return runs.size();
+}
+
+Train::Occupancy Train::occupancy() const {
+    Occupancy summary;
+    std::lock_guard<std::mutex> lock(seatMutex);
+    summary.runs = runs.size();
+    for (const auto& [date, inventory] : runs) {
+        summary.seatsHeld += inventory.seats() - inventory.freeEndToEnd();
+        summary.seatCapacity += inventory.seats();
+    }
+    for (const auto& [date, queue] : waiting) summary.waitingPassengers += queue.passengers();
+    return summary;
+}
+
+// Lazily creates a date's inventory on its first sale
+SeatInventory& Train::run(RunDate date) {
+    auto it = runs.find(date);
+    if (it == runs.end()) {
+        it = runs.emplace(date, SeatInventory(totalSeats.load(), segments())).first;
+    }
+    return it->second;
+}
+
+// A date's list holds at most one train's worth of passengers. Queues are
+// kept once created, even when empty, so places are never handed out twice.
+std::uint64_t Train::takeWaitPlace(RunDate date, int passengers) {
+    WaitQueue& queue = waiting[date];
+    if (passengers <= 0 || queue.passengers() + passengers > totalSeats.load()) return 0;
+    return queue.take();
+}
+
+int Train::waitingPassengers(RunDate date) const {
+    auto it = waiting.find(date);
+    return it == waiting.end() ? 0 : it->second.passengers();
+}
+
+bool Train::joinWaitlist(RunDate date, std::uint64_t seq, const WaitQueue::Entry& entry) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    WaitQueue& queue = waiting[date];
+    if (!queue.insert(seq, entry) || queue.promotionQueued) return false;
+    // Seats freed between the failed booking and now would otherwise wait for the next cancellation
+    if (run(date).freeSeats(entry.from, entry.to) < entry.passengers) return false;
+    queue.promotionQueued = true;
+    return true;
+}
+
+bool Train::restoreWaiting(RunDate date, std::uint64_t seq, const WaitQueue::Entry& entry) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    return waiting[date].insert(seq, entry);
+}
+
+bool Train::leaveWaitlist(RunDate date, std::uint64_t seq) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    auto it = waiting.find(date);
+    return it != waiting.end() && it->second.remove(seq);
+}
+
+bool Train::waitStatus(RunDate date, std::uint64_t seq, WaitClass& waitClass, int& place) const {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    auto it = waiting.find(date);
+    return it != waiting.end() && it->second.position(seq, totalSeats.load(), waitClass, place);
+}
+
+void Train::promoteWaiting(RunDate date, std::vector<WaitQueue::Promotion>& promoted) {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    auto it = waiting.find(date);
+    if (it == waiting.end()) return;
+    it->second.promotionQueued = false;
+    if (it->second.passengers() > 0) it->second.promote(run(date), promoted);
+}
+
+std::vector<RunDate> Train::queuePromotions() {
+    std::lock_guard<std::mutex> lock(seatMutex);
+    std::vector<RunDate> dates;
+    for (auto& entry : waiting) {
+        if (entry.second.passengers() == 0 || entry.second.promotionQueued) continue;
+        entry.second.promotionQueued = true;
+        dates.push_back(entry.first);
+    }
+    return dates;
+}
+
+// Handle to a train: its position in RailwayManager's train storage.
+// Storage is append-only and never reordered, so a handle stays valid for
+// the lifetime of the manager.
+using TrainHandle = std::uint32_t;
+
+/**
+ * @class TrainIndex
+ * @brief Open-addressing hash index from train number to TrainHandle.
+ * Linear probing over a power-of-two table gives O(1) average lookups in
+ * place of a linear std::find_if scan over the train list.
+ */
+class TrainIndex {
+public:
+    static constexpr TrainHandle npos = std::numeric_limits<TrainHandle>::max();
+
+    TrainHandle find(int trainNumber) const;
+    bool insert(int trainNumber, TrainHandle handle);
+    void reserve(std::size_t trains); // Sized so that many never make it grow
+    std::size_t size() const { return count; }
+
+private:
+    struct Slot {
+        int trainNumber = 0;
+        TrainHandle handle = npos; // npos marks an empty slot
+    };
+
+    std::vector<Slot> slots;
+    std::size_t count = 0;
+    int shift = 64; // 64 - log2(slots.size()), for home()
+
+    std::size_t home(int trainNumber) const;
+    void grow();
+    void rehash(std::size_t size); // size is a power of two
+};
+
+std::size_t TrainIndex::home(int trainNumber) const {
+    // Fibonacci hashing: the top bits of the product depend on every bit of
+    // the number, so numbers sharing their low bits still spread out
+    std::uint64_t h = static_cast<std::uint64_t>(static_cast<std::uint32_t>(trainNumber)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<std::size_t>(h >> shift);
+}
+
+TrainHandle TrainIndex::find(int trainNumber) const {
+    if (slots.empty()) return npos;
+    for (std::size_t i = home(trainNumber);; i = (i + 1) & (slots.size() - 1)) {
+        const Slot& slot = slots[i];
+        if (slot.handle == npos) return npos;
+        if (slot.trainNumber == trainNumber) return slot.handle;
+    }
+}
+
+bool TrainIndex::insert(int trainNumber, TrainHandle handle) {
+    // Keep the load factor at or below 1/2 so probe sequences stay short
+    if ((count + 1) * 2 > slots.size()) grow();
+    for (std::size_t i = home(trainNumber);; i = (i + 1) & (slots.size() - 1)) {
+        Slot& slot = slots[i];
+        if (slot.handle == npos) {
+            slot.trainNumber = trainNumber;
+            slot.handle = handle;
+            ++count;
+            return true;
+        }
+        if (slot.trainNumber == trainNumber) return false; // Duplicate train number
+    }
+}
+
+void TrainIndex::grow() {
+    rehash(slots.empty() ? 16 : slots.size() * 2);
+}
+
+// Rehashes at most once, however many trains a bulk load then inserts
+void TrainIndex::reserve(std::size_t trains) {
+    std::size_t wanted = 16;
+    while (wanted < trains * 2) wanted *= 2;
+    if (wanted > slots.size()) rehash(wanted);
+}
+
+void TrainIndex::rehash(std::size_t size) {
+    std::vector<Slot> old;
+    old.swap(slots);
+    slots.assign(size, Slot{});
+    count = 0;
+    shift = 64;
+    for (std::size_t n = size; n > 1; n >>= 1) --shift;
+    for (const Slot& slot : old) {
+        if (slot.handle != npos) insert(slot.trainNumber, slot.handle);
+    }
+}
+
+/**
+ * @class TrainColumns
+ * @brief The catalog's hot fields, one contiguous column each, indexed by
+ * TrainHandle. Sorting and filtering read these arrays instead of striding
+ * across whole Train objects, whose names, stops and seat inventories
+ * would otherwise share the same cache lines.
+ */
+class TrainColumns {
+public:
+    std::vector<std::int32_t> numbers;
+    std::vector<Paise> fares;
+    std::vector<std::int32_t> capacities;
+
+    void append(const Train& train);
+    void reserve(std::size_t trains);
+    std::size_t size() const { return numbers.size(); }
+
+    // mask[h] = 1 for trains with a fare in [minFare, maxFare] and at least
+    // minCapacity seats. Branch-free, so the loop vectorizes.
+    void match(Paise minFare, Paise maxFare, int minCapacity, std::vector<std::uint8_t>& mask) const;
+};
+
+void TrainColumns::append(const Train& train) {
+    numbers.push_back(train.trainNumber);
+    fares.push_back(train.fare.load());
+    capacities.push_back(train.totalSeats.load());
+}
+
+void TrainColumns::reserve(std::size_t trains) {
+    numbers.reserve(trains);
+    fares.reserve(trains);
+    capacities.reserve(trains);
+}
+
+void TrainColumns::match(Paise minFare, Paise maxFare, int minCapacity, std::vector<std::uint8_t>& mask) const {
+    std::size_t n = size();
+    mask.resize(n);
+    const Paise* fare = fares.data();
+    const std::int32_t* capacity = capacities.data();
+    std::uint8_t* out = mask.data();
+    for (std::size_t h = 0; h < n; ++h) {
+        out[h] = static_cast<std::uint8_t>((fare[h] >= minFare) & (fare[h] <= maxFare) & (capacity[h] >= minCapacity));
+    }
+}
+
+// Orderings offered by the train listing
+enum class TrainSortKey { Number, Fare, Name };
+
+// Optional conditions on a train listing; the defaults match every train
+struct TrainFilter {
+    Paise minFare = 0;
+    Paise maxFare = std::numeric_limits<Paise>::max();
+    int minSeats = 0;  // Seats free end to end on date
+    RunDate date = 0;  // Only read when minSeats > 0
+};
+
+/**
+ * @class TrainSortViews
+ * @brief Cached permutation indexes over the train list, one per sort key.
+ * Each view is kept sorted incrementally (binary-search insertion) as trains
+ * are added or re-priced, so listing is a plain walk with no std::sort.
+ */
+class TrainSortViews {
+public:
+    TrainSortViews(const std::deque<Train>& trainList, const TrainColumns& hot)
+        : trains(trainList), columns(hot) {}
+
+    void insert(TrainHandle handle);
+    void fareChanged(TrainHandle handle);
+    void rebuild(); // Re-sorts every view from scratch, for bulk loads
+    const std::vector<TrainHandle>& view(TrainSortKey key) const;
+
+private:
+    const std::deque<Train>& trains;    // Names only
+    const TrainColumns& columns;        // Numbers and fares
+    std::vector<TrainHandle> views[3]; // Indexed by TrainSortKey
+
+    bool less(TrainSortKey key, TrainHandle a, TrainHandle b) const;
+    void insertInto(TrainSortKey key, TrainHandle handle);
+};
+
+// Ties on fare or name fall back to train number so every view is a total order
+bool TrainSortViews::less(TrainSortKey key, TrainHandle a, TrainHandle b) const {
+    switch (key) {
+        case TrainSortKey::Fare:
+            if (columns.fares[a] != columns.fares[b]) return columns.fares[a] < columns.fares[b];
+            break;
+        case TrainSortKey::Name:
+            if (trains[a].nameId != trains[b].nameId) return trains[a].trainName() < trains[b].trainName();
+            break;
+        case TrainSortKey::Number:
+            break;
+    }
+    return columns.numbers[a] < columns.numbers[b];
+}
+
+void TrainSortViews::insertInto(TrainSortKey key, TrainHandle handle) {
+    std::vector<TrainHandle>& v = views[static_cast<int>(key)];
+    auto pos = std::upper_bound(v.begin(), v.end(), handle,
+        [this, key](TrainHandle a, TrainHandle b) { return less(key, a, b); });
+    v.insert(pos, handle);
+}
+
+void TrainSortViews::insert(TrainHandle handle) {
+    insertInto(TrainSortKey::Number, handle);
+    insertInto(TrainSortKey::Fare, handle);
+    insertInto(TrainSortKey::Name, handle);
+}
+
+// Call after a train's fare column has been updated; only the fare view moves
+void TrainSortViews::fareChanged(TrainHandle handle) {
+    std::vector<TrainHandle>& byFare = views[static_cast<int>(TrainSortKey::Fare)];
+    byFare.erase(std::find(byFare.begin(), byFare.end(), handle));
+    insertInto(TrainSortKey::Fare, handle);
+}
+
+void TrainSortViews::rebuild() {
+    for (int k = 0; k < 3; ++k) {
+        TrainSortKey key = static_cast<TrainSortKey>(k);
+        std::vector<TrainHandle>& v = views[k];
+        v.resize(trains.size());
+        for (TrainHandle h = 0; h < v.size(); ++h) v[h] = h;
+        std::sort(v.begin(), v.end(),
+            [this, key](TrainHandle a, TrainHandle b) { return less(key, a, b); });
+    }
+}
+
+const std::vector<TrainHandle>& TrainSortViews::view(TrainSortKey key) const {
+    return views[static_cast<int>(key)];
+}
+
+/**
+ * @class CatalogSnapshot
+ * @brief Immutable copy of what a train listing reads: the hot columns,
+ * the sorted views and where each train lives. The manager publishes one
+ * through an atomic pointer, so listings run without catalogMutex and a
+ * train being added or re-priced never waits for them. Train objects
+ * themselves never move, and the fields a listing shows that can change
+ * are atomic, so the pointers are read directly.
+ */
+struct CatalogSnapshot {
+    std::uint64_t version = 0;         // The catalog change it reflects
+    std::vector<const Train*> trains;  // Indexed by TrainHandle
+    TrainColumns columns;
+    std::vector<TrainHandle> views[3]; // Indexed by TrainSortKey
+
+    const Train& train(TrainHandle handle) const { return *trains[handle]; }
+    const std::vector<TrainHandle>& view(TrainSortKey key) const { return views[static_cast<int>(key)]; }
+};
+
+// Interned station identifier, dense from zero
+using StationId = std::uint32_t;
+
+/**
+ * @class RouteIndex
+ * @brief Station-level view of the catalog for source/destination search.
+ * Station names are interned to StationIds, each train's route is kept as
+ * ordered stops, and an inverted index lists the trains calling at each
+ * station with their position on the route. Journey planning only touches
+ * the trains serving the two end stations (plus, for two changes, the
+ * stations those trains reach), never the whole catalog.
+ */
+class RouteIndex {
+public:
+    static constexpr StationId npos = std::numeric_limits<StationId>::max();
+    static constexpr int kMaxTransfers = 2;
+
+    struct Leg {
+        TrainHandle train;
+        StationId from;
+        StationId to;
+    };
+    using Journey = std::vector<Leg>;
+
+    void addTrain(TrainHandle handle, const Train& train);
+    StationId findStation(const std::string& name) const; // Case-insensitive
+    const std::string& stationName(StationId id) const { return NamePool::instance().text(names[id]); }
+
+    // Up to limit journeys with at most maxTransfers changes, fewest changes first
+    std::vector<Journey> plan(StationId from, StationId to, int maxTransfers, std::size_t limit) const;
+
+private:
+    struct Call {
+        TrainHandle train;
+        std::uint32_t stop; // Position along the train's route
+    };
+
+    std::unordered_map<std::string, StationId> ids; // Keyed by lower-cased name
+    std::unordered_map<NameId, StationId> byName;   // Each spelling met so far
+    std::vector<NameId> names;                      // As first spelled
+    std::vector<std::vector<StationId>> routes;     // By TrainHandle
+    std::vector<std::vector<Call>> calls;           // By StationId
+
+    static std::string key(const std::string& name);
+    StationId intern(NameId name);
+    // Station -> trains that reach it from `origin` (or, reversed, reach `origin` from it)
+    std::unordered_map<StationId, std::vector<TrainHandle>> oneLeg(StationId origin, bool forward) const;
+};
+
+std::string RouteIndex::key(const std::string& name) {
+    std::string lowered(name);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lowered;
+}
+
+// Stations shared across routes are resolved by id after their first
+// sighting; only a new spelling pays for lower-casing the text
+StationId RouteIndex::intern(NameId name) {
+    auto known = byName.find(name);
+    if (known != byName.end()) return known->second;
+    auto inserted = ids.emplace(key(NamePool::instance().text(name)), static_cast<StationId>(names.size()));
+    if (inserted.second) {
+        names.push_back(name);
+        calls.emplace_back();
+    }
+    byName.emplace(name, inserted.first->second);
+    return inserted.first->second;
+}
+
+StationId RouteIndex::findStation(const std::string& name) const {
+    auto it = ids.find(key(name));
+    return it == ids.end() ? npos : it->second;
+}
+
+// Handles arrive in order, since the catalog is append-only
+void RouteIndex::addTrain(TrainHandle handle, const Train& train) {
+    if (routes.size() <= handle) routes.resize(handle + 1);
+    std::vector<StationId>& route = routes[handle];
+    for (int i = 0; i <= train.segments(); ++i) route.push_back(intern(train.stationId(i)));
+    for (std::uint32_t i = 0; i < route.size(); ++i) {
+        calls[route[i]].push_back(Call{handle, i});
+    }
+}
+
+std::unordered_map<StationId, std::vector<TrainHandle>> RouteIndex::oneLeg(StationId origin, bool forward) const {
+    std::unordered_map<StationId, std::vector<TrainHandle>> reach;
+    for (const Call& call : calls[origin]) {
+        const std::vector<StationId>& route = routes[call.train];
+        std::size_t begin = forward ? call.stop + 1 : 0;
+        std::size_t end = forward ? route.size() : call.stop;
+        for (std::size_t i = begin; i < end; ++i) {
+            reach[route[i]].push_back(call.train);
+        }
+    }
+    return reach;
+}
+
+std::vector<RouteIndex::Journey> RouteIndex::plan(StationId from, StationId to, int maxTransfers,
+                                                  std::size_t limit) const {
+    std::vector<Journey> journeys;
+    if (from == to || from >= names.size() || to >= names.size()) return journeys;
+    maxTransfers = std::max(0, std::min(maxTransfers, kMaxTransfers));
+
+    // Direct trains: `to` appears after `from` on the same route
+    auto forward = oneLeg(from, true);
+    auto direct = forward.find(to);
+    if (direct != forward.end()) {
+        for (TrainHandle train : direct->second) {
+            if (journeys.size() >= limit) return journeys;
+            journeys.push_back({Leg{train, from, to}});
+        }
+    }
+    if (maxTransfers < 1 || journeys.size() >= limit) return journeys;
+
+    // One change: meet in the middle between trains out of `from` and into `to`.
+    // Only the first interchange found for each pair of trains is kept.
+    auto backward = oneLeg(to, false);
+    std::set<std::uint64_t> pairs;
+    auto pairKey = [](TrainHandle a, TrainHandle b) { return (std::uint64_t(a) << 32) | b; };
+    for (const auto& entry : backward) {
+        auto out = forward.find(entry.first);
+        if (out == forward.end() || entry.first == from) continue;
+        for (TrainHandle first : out->second) {
+            for (TrainHandle second : entry.second) {
+                if (first == second || !pairs.insert(pairKey(first, second)).second) continue;
+                if (journeys.size() >= limit) return journeys;
+                journeys.push_back({Leg{first, from, entry.first}, Leg{second, entry.first, to}});
+            }
+        }
+    }
+    if (maxTransfers < 2 || journeys.size() >= limit) return journeys;
+
+    std::set<std::array<TrainHandle, 3>> triples;
+    // Two changes: a middle train links a station reachable from `from`
+    // to a station that reaches `to`. Every train into the first change and
+    // out of the second is paired with it, as in the one-change stage.
+    for (const auto& out : forward) {
+        StationId x = out.first;
+        if (x == to) continue;
+        for (const Call& call : calls[x]) {
+            const std::vector<StationId>& route = routes[call.train];
+            for (std::size_t i = call.stop + 1; i < route.size(); ++i) {
+                StationId y = route[i];
+                auto in = backward.find(y);
+                if (in == backward.end() || y == from) continue;
+                for (TrainHandle first : out.second) {
+                    if (first == call.train) continue;
+                    for (TrainHandle last : in->second) {
+                        if (last == call.train || first == last) continue;
+                        if (!triples.insert({first, call.train, last}).second) continue;
+                        journeys.push_back({Leg{first, from, x}, Leg{call.train, x, y}, Leg{last, y, to}});
+                        if (journeys.size() >= limit) return journeys;
+                    }
+                }
+            }
+        }
+    }
+    return journeys;
+}
+
+/**
+ * @class PnrAllocator
+ * @brief Hands out unique, hard-to-guess 10-digit PNRs in constant time.
+ * The 10-digit range is cut into one block per ticket store shard, so a
+ * PNR names its shard by arithmetic alone: any front end can route a
+ * lookup by PNR straight to the shard holding it, with no table and no
+ * key. Within a block, each shard's atomic counter is passed through a
+ * keyed Feistel permutation of the 28-bit space, cycle-walking any output
+ * outside the block. Until a shard's counter has issued kShardRange PNRs,
+ * distinct counter values give distinct PNRs, so there is no retry against
+ * the ticket store, and concurrent callers need only one fetch_add. After
+ * that the counter wraps and the sequence repeats, reusing the PNRs of
+ * tickets that are gone. A booking then retries PNRs still in use, at
+ * most kMaxAttempts times, and fails if the block is that full.
+ */
+class PnrAllocator {
+public:
+    static constexpr Pnr kFirst = 1000000000ULL; // Smallest 10-digit PNR
+    static constexpr Pnr kRange = 9000000000ULL; // Count of 10-digit PNRs
+    static constexpr std::size_t kShards = 64;
+    static constexpr Pnr kShardRange = kRange / kShards; // PNRs per shard, 140,625,000
+    static constexpr int kMaxAttempts = 64; // PNRs a booking tries once its shard has wrapped
+    using Issued = std::array<std::uint64_t, kShards>;
+
+    explicit PnrAllocator(std::uint64_t seed) { restore(seed, Issued{}); }
+    Pnr next(std::size_t shard);
+    // The shard a PNR was allocated for; 0 for anything that isn't a 10-digit PNR
+    static std::size_t shardOf(Pnr pnr) {
+        return pnr >= kFirst && pnr < kFirst + kRange ? static_cast<std::size_t>((pnr - kFirst) / kShardRange) : 0;
+    }
+
+    // Persisted so a restarted process continues the same sequences
+    std::uint64_t seed() const { return keySeed; }
+    Issued issued() const;
+
+    // Startup only: not safe to call while PNRs are being allocated
+    void restore(std::uint64_t seed, const Issued& issued);
+    void advancePast(Pnr pnr);
+
+private:
+    static constexpr int kHalfBits = 14; // Two halves of the 28-bit block
+    static constexpr std::uint64_t kHalfMask = (1ULL << kHalfBits) - 1;
+    static constexpr int kRounds = 4;
+
+    // Cache-line aligned so shards booking at once don't false-share
+    struct alignas(64) Counter {
+        std::atomic<std::uint64_t> issued{0};
+    };
+
+    std::array<Counter, kShards> counters;
+    std::uint64_t keySeed = 0;
+    std::uint64_t roundKeys[kRounds];
+
+    std::uint64_t roundFunction(std::uint64_t half, std::uint64_t key) const;
+    std::uint64_t permute(std::uint64_t block) const;
+    std::uint64_t unpermute(std::uint64_t block) const;
+};
+
+PnrAllocator::Issued PnrAllocator::issued() const {
+    Issued issued;
+    for (std::size_t i = 0; i < kShards; ++i) issued[i] = counters[i].issued.load();
+    return issued;
+}
+
+void PnrAllocator::restore(std::uint64_t seed, const Issued& issued) {
+    keySeed = seed;
+    for (std::size_t i = 0; i < kShards; ++i) counters[i].issued.store(issued[i]);
+    // splitmix64 expands the seed into independent round keys
+    for (std::uint64_t& key : roundKeys) {
+        seed += 0x9E3779B97F4A7C15ULL;
+        std::uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        key = z ^ (z >> 31);
+    }
+}
+
+std::uint64_t PnrAllocator::roundFunction(std::uint64_t half, std::uint64_t key) const {
+    std::uint64_t f = (half ^ key) * 0xD6E8FEB86659FD93ULL;
+    f ^= f >> 32;
+    return f & kHalfMask;
+}
+
+// A bijection on [0, 2^28); each round mixes one half into the other
+std::uint64_t PnrAllocator::permute(std::uint64_t block) const {
+    std::uint64_t left = block >> kHalfBits;
+    std::uint64_t right = block & kHalfMask;
+    for (int r = 0; r < kRounds; ++r) {
+        std::uint64_t mixed = left ^ roundFunction(right, roundKeys[r]);
+        left = right;
+        right = mixed;
+    }
+    return (left << kHalfBits) | right;
+}
+
+// Runs the rounds backwards, recovering the counter value behind a PNR
+std::uint64_t PnrAllocator::unpermute(std::uint64_t block) const {
+    std::uint64_t left = block >> kHalfBits;
+    std::uint64_t right = block & kHalfMask;
+    for (int r = kRounds - 1; r >= 0; --r) {
+        std::uint64_t original = right ^ roundFunction(left, roundKeys[r]);
+        right = left;
+        left = original;
+    }
+    return (left << kHalfBits) | right;
+}
+
+// Moves the PNR's shard counter beyond it, for PNRs replayed from the journal
+void PnrAllocator::advancePast(Pnr pnr) {
+    if (pnr < kFirst || pnr >= kFirst + kRange) return;
+    std::size_t shard = shardOf(pnr);
+    std::uint64_t value = pnr - kFirst - shard * kShardRange;
+    do {
+        value = unpermute(value);
+    } while (value >= kShardRange);
+    std::atomic<std::uint64_t>& counter = counters[shard].issued;
+    if (value + 1 > counter.load()) counter.store(value + 1);
+}
+
+Pnr PnrAllocator::next(std::size_t shard) {
+    std::uint64_t value = counters[shard].issued.fetch_add(1, std::memory_order_relaxed) % kShardRange;
+    // Cycle-walking keeps the permutation inside [0, kShardRange); since
+    // 2^28 < 2 * kShardRange this takes under two steps on average
+    do {
+        value = permute(value);
+    } while (value >= kShardRange);
+    return kFirst + shard * kShardRange + value;
+}
+
+// Confirmed tickets hold seats; waiting ones hold a place in their run's WaitQueue
+enum class TicketStatus : std::uint8_t { Confirmed, Waiting };
+
+/**
+ * @class Ticket
+ * @brief Represents a booked ticket, connecting Passengers to a Train.
+ * Stored in a hash table for efficient PNR-based searching. The train is referenced
+ * by handle rather than copied; only the fares are snapshotted, each
+ * passenger's as priced at booking, so the amount billed is unaffected by
+ * later fare changes.
+ */
+class Ticket {
+public:
+    Pnr pnr;
+    TrainHandle train;
+    int trainNumber;
+    PassengerList passengers; // Each with the fare charged for them
+    Quota quota = Quota::General;
+    NameId bookedBy;         // Interned username
+    RunDate travelDate = 0;
+    int fromStation = 0;     // Leg travelled, as Train station indexes
+    int toStation = 0;
+    SeatList seats;          // Seat number per passenger, in passenger order; empty while waiting
+    TicketStatus status = TicketStatus::Confirmed;
+    std::uint64_t waitSeq = 0; // Place in the run's WaitQueue, for tickets that waited
+
+    Ticket(Pnr pnrNum, TrainHandle handle, int number, NameId username, PassengerList travellers = {});
+    const std::string& bookedByUsername() const { return NamePool::instance().text(bookedBy); }
+    void addPassenger(const Passenger& passenger);
+    Paise totalFare() const;
+    void display(const Train& trainDetails) const;
+    void render(OutputBuffer& out, const Train& trainDetails) const;
+    void renderStatus(OutputBuffer& out, const Train& trainDetails) const; // CNF, RAC n or WL n
+};
+
+// Passengers arrive priced, from FareEngine at booking or from disk
+Ticket::Ticket(Pnr pnrNum, TrainHandle handle, int number, NameId username, PassengerList travellers)
+    : pnr(pnrNum), train(handle), trainNumber(number), passengers(std::move(travellers)), bookedBy(username) {}
+
+void Ticket::addPassenger(const Passenger& passenger) {
+    passengers.push_back(passenger);
+}
+
+Paise Ticket::totalFare() const {
+    Paise total = 0;
+    for (const Passenger& passenger : passengers) total += passenger.fare;
+    return total;
+}
+
+// trainDetails is the catalog entry for this ticket's handle
+void Ticket::display(const Train& trainDetails) const {
+    OutputBuffer out;
+    render(out, trainDetails);
+}
+
+void Ticket::render(OutputBuffer& out, const Train& trainDetails) const {
+    printHeader(out, "TICKET DETAILS");
+    out << "  PNR Number: " << pnr;
+    out.line() << "  Booked By: " << bookedByUsername();
+    out.line() << "  Train No:   " << trainNumber << " (" << trainDetails.trainName() << ')';
+    out.line() << "  Travel On:  ";
+    renderDate(out, travelDate);
+    out.line() << "  Route:      " << trainDetails.stationName(fromStation) << " -> "
+               << trainDetails.stationName(toStation);
+    out.line() << "  Status:     ";
+    renderStatus(out, trainDetails);
+    out.line() << "  Quota:      " << quotaName(quota);
+    out.line() << "  Total Fare: Rs. ";
+    out.money(totalFare());
+    out.line().line() << "--- Passengers (" << passengers.size() << ") ---";
+    out.line();
+    for (std::size_t i = 0; i < passengers.size(); ++i) {
+        if (i < seats.size()) {
+            out << "      Seat " << seats[i] + 1;
+            out.line();
+        }
+        passengers[i].render(out);
+    }
+    out.repeat('-', 80).line();
+}
+
+// The place is looked up live, so it improves as tickets ahead are confirmed
+// or cancelled. A list that has been evicted with its date shows as plain WL.
+void Ticket::renderStatus(OutputBuffer& out, const Train& trainDetails) const {
+    WaitClass waitClass;
+    int place;
+    if (status == TicketStatus::Confirmed) {
+        out << "CNF";
+    } else if (trainDetails.waitStatus(travelDate, waitSeq, waitClass, place)) {
+        out << (waitClass == WaitClass::Rac ? "RAC " : "WL ") << place;
+    } else {
+        out << "WL";
+    }
+}
+
+/**
+ * @class PnrList
+ * @brief PNRs in the order they were added, each removable in amortized
+ * O(1). A removed PNR leaves a hole that visits skip, found through a map
+ * of positions, and the array is compacted once holes outnumber the PNRs
+ * left, so the order is kept without shifting the array on every removal.
+ * Not synchronized; owners lock around it.
+ */
+class PnrList {
+public:
+    void add(Pnr pnr);       // Ignored if already listed
+    bool remove(Pnr pnr);    // False if it isn't listed
+    bool empty() const { return positions.empty(); }
+    std::vector<Pnr> toVector() const;
+    template <typename Fn>
+    void forEach(Fn& fn) const {
+        for (Pnr pnr : slots) {
+            if (pnr != kHole) fn(pnr);
+        }
+    }
+
+private:
+    static constexpr Pnr kHole = 0; // Below PnrAllocator::kFirst, so never a ticket's
+
+    std::vector<Pnr> slots;
+    std::unordered_map<Pnr, std::size_t> positions;
+
+    void compact();
+};
+
+void PnrList::add(Pnr pnr) {
+    if (positions.emplace(pnr, slots.size()).second) slots.push_back(pnr);
+}
+
+bool PnrList::remove(Pnr pnr) {
+    auto it = positions.find(pnr);
+    if (it == positions.end()) return false;
+    slots[it->second] = kHole;
+    positions.erase(it);
+    if (positions.size() * 2 < slots.size()) compact();
+    return true;
+}
+
+std::vector<Pnr> PnrList::toVector() const {
+    std::vector<Pnr> pnrs;
+    pnrs.reserve(positions.size());
+    for (Pnr pnr : slots) {
+        if (pnr != kHole) pnrs.push_back(pnr);
+    }
+    return pnrs;
+}
+
+// Paid for by the removals that made the holes
+void PnrList::compact() {
+    slots.erase(std::remove(slots.begin(), slots.end(), kHole), slots.end());
+    for (std::size_t i = 0; i < slots.size(); ++i) positions[slots[i]] = i;
+}
+
+/**
+ * @class TicketIndex
+ * @brief Striped secondary index from a key, such as a user, to the PNRs booked
+ * under it. Lookups cost time proportional to that key's own tickets rather
+ * than to every ticket in the system.
+ */
+template <typename Key, typename Hash = std::hash<Key>>
+class TicketIndex {
+public:
+    void add(const Key& key, Pnr pnr);
+    void remove(const Key& key, Pnr pnr); // A PNR not listed under key is ignored
+    void removeMany(const Key& key, const std::vector<Pnr>& pnrs); // One hold of the stripe lock
+    std::vector<Pnr> lookup(const Key& key) const; // PNRs in booking order
+
+private:
+    static constexpr std::size_t kStripes = 64;
+
+    struct alignas(64) Stripe {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, PnrList, Hash> pnrs;
+    };
+
+    std::array<Stripe, kStripes> stripes;
+
+    Stripe& stripeFor(const Key& key) { return stripes[Hash{}(key) % kStripes]; }
+    const Stripe& stripeFor(const Key& key) const { return stripes[Hash{}(key) % kStripes]; }
+};
+
+template <typename Key, typename Hash>
+void TicketIndex<Key, Hash>::add(const Key& key, Pnr pnr) {
+    Stripe& stripe = stripeFor(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    stripe.pnrs[key].add(pnr);
+}
+
+template <typename Key, typename Hash>
+void TicketIndex<Key, Hash>::remove(const Key& key, Pnr pnr) {
+    Stripe& stripe = stripeFor(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.pnrs.find(key);
+    if (it == stripe.pnrs.end()) return;
+    it->second.remove(pnr);
+    if (it->second.empty()) stripe.pnrs.erase(it);
+}
+
+template <typename Key, typename Hash>
+void TicketIndex<Key, Hash>::removeMany(const Key& key, const std::vector<Pnr>& pnrs) {
+    Stripe& stripe = stripeFor(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.pnrs.find(key);
+    if (it == stripe.pnrs.end()) return;
+    for (Pnr pnr : pnrs) it->second.remove(pnr);
+    if (it->second.empty()) stripe.pnrs.erase(it);
+}
+
+template <typename Key, typename Hash>
+std::vector<Pnr> TicketIndex<Key, Hash>::lookup(const Key& key) const {
+    const Stripe& stripe = stripeFor(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.pnrs.find(key);
+    return it == stripe.pnrs.end() ? std::vector<Pnr>() : it->second.toVector();
+}
+
+/**
+ * @class SlabPool
+ * @brief Fixed-size block allocator backed by large slabs.
+ * Blocks are carved out of slabs of kBlocksPerSlab, and freed blocks go on
+ * an intrusive free list to be handed out again, so steady booking and
+ * cancellation traffic never reaches the general heap. The block size is
+ * fixed by the first allocation. Not synchronized; owners lock around it.
+ */
+class SlabPool {
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    bool fits(std::size_t bytes);   // Fixes the block size on first use
+    void* allocate();
+    void release(void* block);
+    std::size_t slabCount() const { return slabs.size(); }
+
+private:
+    static constexpr std::size_t kBlocksPerSlab = 256;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    std::size_t blockSize = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> slabs;
+    std::size_t carved = kBlocksPerSlab; // Blocks handed out of the newest slab
+    FreeBlock* freeList = nullptr;
+};
+
+bool SlabPool::fits(std::size_t bytes) {
+    if (blockSize == 0) {
+        std::size_t align = alignof(std::max_align_t);
+        blockSize = (std::max(bytes, sizeof(FreeBlock)) + align - 1) / align * align;
+    }
+    return bytes <= blockSize;
+}
+
+void* SlabPool::allocate() {
+    if (freeList) {
+        FreeBlock* block = freeList;
+        freeList = block->next;
+        return block;
+    }
+    if (carved == kBlocksPerSlab) {
+        slabs.emplace_back(new unsigned char[blockSize * kBlocksPerSlab]);
+        carved = 0;
+    }
+    return slabs.back().get() + blockSize * carved++;
+}
+
+void SlabPool::release(void* block) {
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = freeList;
+    freeList = freed;
+}
+
+/**
+ * @class PnrTable
+ * @brief Open-addressing hash table from PNR to ticket, one per store shard.
+ * Slots are 16 bytes in one array, probed linearly, so a lookup touches a
+ * cache line or two instead of chasing tree nodes. Tickets themselves sit
+ * in the shard's SlabPool and never move, which lets readers keep pointers
+ * to them. Erasing shifts the rest of the probe run back, so there are no
+ * tombstones. Not synchronized; the shard lock covers it.
+ */
+class PnrTable {
+public:
+    Ticket* find(Pnr pnr) const; // nullptr if absent
+    bool insert(Ticket* ticket); // Keyed by its PNR; false if that is taken
+    Ticket* replace(Ticket* ticket); // Swaps in a ticket for a present PNR; returns the old one
+    Ticket* erase(Pnr pnr); // Returns what was stored, nullptr if absent
+    std::size_t size() const { return count; }
+
+    // Visits every ticket, in slot order
+    template <typename Fn>
+    void forEach(Fn& fn) const {
+        for (const Slot& slot : slots) {
+            if (slot.ticket) fn(*slot.ticket);
+        }
+    }
+
+private:
+    struct Slot {
+        Pnr pnr = 0;
+        Ticket* ticket = nullptr; // nullptr marks an empty slot
+    };
+
+    std::vector<Slot> slots;
+    std::size_t count = 0;
+
+    std::size_t home(Pnr pnr) const;
+    std::size_t locate(Pnr pnr) const; // The PNR's slot, or the empty slot ending its probe run
+    void grow();
+};
+
+std::size_t PnrTable::home(Pnr pnr) const {
+    // A shard's PNRs share their leading digits, so mix before masking
+    return static_cast<std::size_t>((pnr * 0x9E3779B97F4A7C15ULL) >> 32) & (slots.size() - 1);
+}
+
+std::size_t PnrTable::locate(Pnr pnr) const {
+    std::size_t i = home(pnr);
+    while (slots[i].ticket && slots[i].pnr != pnr) i = (i + 1) & (slots.size() - 1);
+    return i;
+}
+
+Ticket* PnrTable::find(Pnr pnr) const {
+    return slots.empty() ? nullptr : slots[locate(pnr)].ticket;
+}
+
+bool PnrTable::insert(Ticket* ticket) {
+    // Keep the load factor at or below 1/2 so probe runs stay short
+    if ((count + 1) * 2 > slots.size()) grow();
+    Slot& slot = slots[locate(ticket->pnr)];
+    if (slot.ticket) return false;
+    slot = Slot{ticket->pnr, ticket};
+    ++count;
+    return true;
+}
+
+Ticket* PnrTable::replace(Ticket* ticket) {
+    Ticket*& stored = slots[locate(ticket->pnr)].ticket;
+    Ticket* old = stored;
+    stored = ticket;
+    return old;
+}
+
+Ticket* PnrTable::erase(Pnr pnr) {
+    if (slots.empty()) return nullptr;
+    std::size_t mask = slots.size() - 1;
+    std::size_t hole = locate(pnr);
+    Ticket* erased = slots[hole].ticket;
+    if (!erased) return nullptr;
+    // Entries after the hole move back into it unless their home lies
+    // cyclically in (hole, j], where the hole isn't on their probe path
+    for (std::size_t j = (hole + 1) & mask; slots[j].ticket; j = (j + 1) & mask) {
+        std::size_t want = home(slots[j].pnr);
+        bool stays = hole <= j ? (hole < want && want <= j) : (hole < want || want <= j);
+        if (stays) continue;
+        slots[hole] = slots[j];
+        hole = j;
+    }
+    slots[hole] = Slot{};
+    --count;
+    return erased;
+}
+
+void PnrTable::grow() {
+    std::vector<Slot> old;
+    old.swap(slots);
+    slots.assign(old.empty() ? 64 : old.size() * 2, Slot{});
+    count = 0;
+    for (const Slot& slot : old) {
+        if (slot.ticket) insert(slot.ticket);
+    }
+}
+
+/**
+ * @class TicketAggregates
+ * @brief Running totals over live tickets, per train and overall: tickets,
+ * passengers, those still waiting, revenue, and passengers by gender and
+ * age band. TicketStore applies every insert, removal and change, so a
+ * dashboard reads them in O(1) instead of scanning tickets. Updates are
+ * relaxed atomic adds; the overall totals are striped like the metrics.
+ */
+class TicketAggregates {
+public:
+    enum Field {
+        Tickets,
+        Passengers,
+        Waiting,      // Passengers on RAC or the waiting list
+        RevenuePaise, // Fares of live tickets, in paise
+        Male,
+        Female,
+        OtherGender,
+        Children,     // Under 12
+        Youths,       // 12 to 17
+        Adults,       // 18 to 59
+        Seniors,      // 60 and over
+        kFields
+    };
+    using Values = std::array<std::int64_t, kFields>;
+    static constexpr std::array<const char*, kFields> kNames = {
+        "tickets", "passengers", "waiting", "revenue", "male", "female", "other",
+        "children", "youths", "adults", "seniors"};
+
+    static Values measure(const Ticket& ticket); // One ticket's contribution
+    static void add(Values& into, const Values& values);
+
+    // A slot per train handle; like every update, under the catalog lock, but exclusively
+    void trackTrains(std::size_t count);
+    void apply(const Ticket& ticket, std::int64_t sign); // +1 as it is stored, -1 as it goes
+    Values ofTrain(TrainHandle train) const;
+    Values overall() const;
+
+private:
+    struct alignas(64) Counters {
+        std::array<std::atomic<std::int64_t>, kFields> values{};
+        Values read() const;
+    };
+    std::deque<Counters> perTrain; // A deque, so growing never moves the atomics
+    std::array<Counters, kCounterStripes> totals;
+};
+
+TicketAggregates::Values TicketAggregates::measure(const Ticket& ticket) {
+    Values values{};
+    std::int64_t travellers = static_cast<std::int64_t>(ticket.passengers.size());
+    values[Tickets] = 1;
+    values[Passengers] = travellers;
+    values[Waiting] = ticket.status == TicketStatus::Waiting ? travellers : 0;
+    values[RevenuePaise] = ticket.totalFare();
+    for (const Passenger& passenger : ticket.passengers) {
+        char gender = static_cast<char>(std::toupper(static_cast<unsigned char>(passenger.gender)));
+        ++values[gender == 'M' ? Male : gender == 'F' ? Female : OtherGender];
+        ++values[passenger.age < 12 ? Children : passenger.age < 18 ? Youths : passenger.age < 60 ? Adults : Seniors];
+    }
+    return values;
+}
+
+void TicketAggregates::add(Values& into, const Values& values) {
+    for (std::size_t f = 0; f < kFields; ++f) into[f] += values[f];
+}
+
+void TicketAggregates::trackTrains(std::size_t count) {
+    while (perTrain.size() < count) perTrain.emplace_back();
+}
+
+void TicketAggregates::apply(const Ticket& ticket, std::int64_t sign) {
+    Values values = measure(ticket);
+    Counters& train = perTrain[ticket.train];
+    Counters& total = totals[counterStripe()];
+    for (std::size_t f = 0; f < kFields; ++f) {
+        if (!values[f]) continue;
+        train.values[f].fetch_add(sign * values[f], std::memory_order_relaxed);
+        total.values[f].fetch_add(sign * values[f], std::memory_order_relaxed);
+    }
+}
+
+TicketAggregates::Values TicketAggregates::Counters::read() const {
+    Values snapshot;
+    for (std::size_t f = 0; f < kFields; ++f) snapshot[f] = values[f].load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+TicketAggregates::Values TicketAggregates::ofTrain(TrainHandle train) const {
+    return train < perTrain.size() ? perTrain[train].read() : Values{};
+}
+
+TicketAggregates::Values TicketAggregates::overall() const {
+    Values sum{};
+    for (const Counters& stripe : totals) add(sum, stripe.read());
+    return sum;
+}
+
+/**
+ * @class TicketStore
+ * @brief PNR-keyed ticket store partitioned into independently locked shards.
+ * A train's tickets all live in one shard, chosen from its handle, along
+ * with the train's manifest. Each PNR encodes the shard it was allocated
+ * for (see PnrAllocator), so a lookup by PNR goes straight to its shard
+ * and never has to ask the others. Bookings and cancellations on trains
+ * in different shards never contend. A shard owns nothing another shard
+ * needs, so shards could be spread across processes by the same routing.
+ *
+ * A stored ticket is never changed in place. A change stores an updated
+ * copy in its place, and a replaced or removed ticket is retired to the
+ * EpochDomain rather than freed. Readers snapshot pointers under a shard
+ * lock and render from them after releasing it, for as long as they stay
+ * pinned.
+ */
+class TicketStore {
+public:
+    static constexpr std::size_t kShards = PnrAllocator::kShards;
+    using Snapshot = std::vector<const Ticket*>; // Valid while the reader stays pinned
+
+    explicit TicketStore(EpochDomain& readers) : epochs(readers) {}
+
+    // The shard a train's tickets live in; allocate their PNRs for it
+    static std::size_t shardOfTrain(TrainHandle train) { return train % kShards; }
+
+    bool insert(Ticket&& ticket); // false (ticket untouched) if the PNR is taken
+    bool contains(Pnr pnr) const;
+    std::optional<Ticket> find(Pnr pnr) const;
+    std::optional<Ticket> extract(Pnr pnr, NameId owner);
+    // Removes many tickets, whoever booked them, taking each shard lock once;
+    // returns those that were present
+    std::vector<Ticket> extractAll(const std::vector<Pnr>& pnrs);
+    bool empty() const;
+
+    // Updates a ticket under its shard's lock; false if there is no such
+    // ticket. fn edits a copy that then replaces the ticket, since readers may
+    // hold the old one. It must not change the owner or train the indexes key on.
+    template <typename Fn>
+    bool modify(Pnr pnr, Fn fn) {
+        Shard& shard = shardFor(pnr);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const Ticket* current = shard.tickets.find(pnr);
+        if (!current) return false;
+        Ticket changed(*current);
+        fn(changed);
+        aggregates.apply(*current, -1);
+        aggregates.apply(changed, 1);
+        retire(shard, shard.tickets.replace(place(shard, std::move(changed))));
+        return true;
+    }
+
+    // Visits every ticket, one shard at a time under that shard's lock
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (std::size_t shard = 0; shard < kShards; ++shard) forEachInShard(shard, fn);
+    }
+    // One shard's tickets; shards can be visited from different threads at once
+    template <typename Fn>
+    void forEachInShard(std::size_t index, Fn& fn) const {
+        const Shard& shard = shards[index];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.tickets.forEach(fn);
+    }
+
+    // Visits one user's tickets via the user index, or one train's manifest
+    // in booking order, under a single hold of its shard's lock
+    template <typename Fn>
+    void forEachOfUser(NameId username, Fn fn) const { visit(byUser.lookup(username), fn); }
+    template <typename Fn>
+    void forEachOnTrain(TrainHandle train, Fn fn) const {
+        const Shard& shard = shards[shardOfTrain(train)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.manifests.find(train);
+        if (it == shard.manifests.end()) return;
+        auto visitTicket = [&shard, &fn](Pnr pnr) { fn(*shard.tickets.find(pnr)); };
+        it->second.forEach(visitTicket);
+    }
+
+    // Snapshots for lock-free reads: the caller pins readEpochs() first and keeps
+    // the pin while it uses them. Each shard is captured under its lock.
+    EpochDomain& readEpochs() const { return epochs; }
+    void snapshotShard(std::size_t index, Snapshot& into) const;
+    Snapshot snapshotOfUser(NameId username) const;
+    Snapshot snapshotOnTrain(TrainHandle train) const;
+
+    // Totals kept up to date with every change; see TicketAggregates
+    const TicketAggregates& totals() const { return aggregates; }
+    void trackTrains(std::size_t count) { aggregates.trackTrains(count); } // Caller holds catalogMutex exclusively
+
+private:
+    // Frees a ticket placed in a shard's pool
+    struct PoolDelete {
+        SlabPool* pool;
+        void operator()(Ticket* ticket) const {
+            ticket->~Ticket();
+            pool->release(ticket);
+        }
+    };
+    using PooledTicket = std::unique_ptr<Ticket, PoolDelete>;
+
+    // Cache-line aligned so neighbouring shard locks don't false-share.
+    // Tickets are placed in the shard's own pool, which the shard lock covers.
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        SlabPool pool; // Declared first: it must outlive the tickets
+        PnrTable tickets;
+        std::unordered_map<TrainHandle, PnrList> manifests; // Per train, in booking order
+        RetireList<PooledTicket> retired; // Unlinked tickets readers may still hold
+
+        ~Shard() {
+            auto destroy = [](const Ticket& ticket) { ticket.~Ticket(); };
+            tickets.forEach(destroy); // Their blocks go with the pool
+        }
+    };
+
+    EpochDomain& epochs;
+    std::array<Shard, kShards> shards;
+    TicketIndex<NameId> byUser;
+    TicketAggregates aggregates;
+
+    Shard& shardFor(Pnr pnr) { return shards[PnrAllocator::shardOf(pnr)]; }
+    const Shard& shardFor(Pnr pnr) const { return shards[PnrAllocator::shardOf(pnr)]; }
+
+    // Caller holds the shard's lock
+    static Ticket* place(Shard& shard, Ticket&& ticket) {
+        shard.pool.fits(sizeof(Ticket));
+        return new (shard.pool.allocate()) Ticket(std::move(ticket));
+    }
+    // Caller holds the shard's lock. Tickets retired earlier are freed here
+    // once they are safe, so the pool gets them back on a later write.
+    void retire(Shard& shard, Ticket* ticket) {
+        shard.retired.retire(epochs, PooledTicket(ticket, PoolDelete{&shard.pool}));
+        shard.retired.reclaim(epochs);
+    }
+
+    // PNRs whose ticket is gone by the time it is visited are skipped
+    template <typename Fn>
+    void visit(const std::vector<Pnr>& pnrs, Fn& fn) const {
+        for (Pnr pnr : pnrs) {
+            const Shard& shard = shardFor(pnr);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (const Ticket* ticket = shard.tickets.find(pnr)) fn(*ticket);
+        }
+    }
+};
+
+bool TicketStore::insert(Ticket&& ticket) {
+    Pnr pnr = ticket.pnr;
+    Shard& shard = shardFor(pnr);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.retired.reclaim(epochs);
+    if (shard.tickets.find(pnr)) return false;
+    Ticket* stored = place(shard, std::move(ticket));
+    shard.tickets.insert(stored);
+    shard.manifests[stored->train].add(pnr);
+    byUser.add(stored->bookedBy, pnr);
+    aggregates.apply(*stored, 1);
+    return true;
+}
+
+bool TicketStore::contains(Pnr pnr) const {
+    const Shard& shard = shardFor(pnr);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.tickets.find(pnr) != nullptr;
+}
+
+std::optional<Ticket> TicketStore::find(Pnr pnr) const {
+    const Shard& shard = shardFor(pnr);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const Ticket* ticket = shard.tickets.find(pnr);
+    if (!ticket) return std::nullopt;
+    return *ticket;
+}
+
+// Removes and returns the ticket, but only if it was booked by owner
+std::optional<Ticket> TicketStore::extract(Pnr pnr, NameId owner) {
+    Shard& shard = shardFor(pnr);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const Ticket* stored = shard.tickets.find(pnr);
+    if (!stored || stored->bookedBy != owner) {
+        return std::nullopt;
+    }
+    std::optional<Ticket> ticket(*stored); // A copy: readers may still be using the stored one
+    retire(shard, shard.tickets.erase(pnr));
+    auto manifest = shard.manifests.find(ticket->train);
+    if (manifest != shard.manifests.end()) {
+        manifest->second.remove(pnr);
+        if (manifest->second.empty()) shard.manifests.erase(manifest);
+    }
+    byUser.remove(ticket->bookedBy, pnr);
+    aggregates.apply(*ticket, -1);
+    return ticket;
+}
+
+std::vector<Ticket> TicketStore::extractAll(const std::vector<Pnr>& pnrs) {
+    std::array<std::vector<Pnr>, kShards> perShard;
+    for (Pnr pnr : pnrs) perShard[PnrAllocator::shardOf(pnr)].push_back(pnr);
+    std::vector<Ticket> extracted;
+    extracted.reserve(pnrs.size());
+    for (std::size_t i = 0; i < kShards; ++i) {
+        if (perShard[i].empty()) continue;
+        Shard& shard = shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (Pnr pnr : perShard[i]) {
+            Ticket* ticket = shard.tickets.erase(pnr);
+            if (!ticket) continue;
+            extracted.push_back(*ticket);
+            auto manifest = shard.manifests.find(ticket->train);
+            if (manifest != shard.manifests.end()) {
+                manifest->second.remove(pnr);
+                if (manifest->second.empty()) shard.manifests.erase(manifest);
+            }
+            shard.retired.retire(epochs, PooledTicket(ticket, PoolDelete{&shard.pool}));
+        }
+        shard.retired.reclaim(epochs);
+    }
+
+    std::unordered_map<NameId, std::vector<Pnr>> ofUser;
+    for (const Ticket& ticket : extracted) {
+        ofUser[ticket.bookedBy].push_back(ticket.pnr);
+        aggregates.apply(ticket, -1);
+    }
+    for (const auto& [username, removed] : ofUser) byUser.removeMany(username, removed);
+    return extracted;
+}
+
+void TicketStore::snapshotShard(std::size_t index, Snapshot& into) const {
+    const Shard& shard = shards[index];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    into.reserve(into.size() + shard.tickets.size());
+    auto take = [&into](const Ticket& ticket) { into.push_back(&ticket); };
+    shard.tickets.forEach(take);
+}
+
+TicketStore::Snapshot TicketStore::snapshotOfUser(NameId username) const {
+    Snapshot tickets;
+    auto take = [&tickets](const Ticket& ticket) { tickets.push_back(&ticket); };
+    visit(byUser.lookup(username), take);
+    return tickets;
+}
+
+TicketStore::Snapshot TicketStore::snapshotOnTrain(TrainHandle train) const {
+    Snapshot tickets;
+    forEachOnTrain(train, [&tickets](const Ticket& ticket) { tickets.push_back(&ticket); });
+    return tickets;
+}
+
+bool TicketStore::empty() const {
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.tickets.size() != 0) return false;
+    }
+    return true;
+}
+
+/**
+ * @class User
+ * @brief Represents a user account in the system.
+ */
+class User {
+public:
+    NameId name;            // Interned username
+    std::string credential; // Salted password hash from PasswordHasher, never the password
+    bool isAdmin;
+
+    User(NameId uname, std::string hash, bool admin = false)
+        : name(uname), credential(std::move(hash)), isAdmin(admin) {}
+    const std::string& username() const { return NamePool::instance().text(name); }
+};
+
+// =====================================================================
+// PERSISTENCE
+// =====================================================================
+
+// Standard CRC-32 (IEEE), used to detect torn or corrupt records on disk
+std::uint32_t crc32(const char* data, std::size_t length) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * @class BinaryWriter
+ * @brief Appends fixed-width fields and length-prefixed strings to a buffer.
+ * Journal records and snapshots share this encoding (native byte order).
+ */
+class BinaryWriter {
+public:
+    template <typename T>
+    void put(T value) {
+        static_assert(std::is_trivially_copyable<T>::value, "put() takes plain values");
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void putString(const std::string& value) {
+        put(static_cast<std::uint32_t>(value.size()));
+        buffer.append(value);
+    }
+    const std::string& data() const { return buffer; }
+
+private:
+    std::string buffer;
+};
+
+/**
+ * @class BinaryReader
+ * @brief Reads back what BinaryWriter wrote; every get fails cleanly on
+ * truncated input instead of reading past the end.
+ */
+class BinaryReader {
+public:
+    BinaryReader(const char* begin, std::size_t length) : cursor(begin), end(begin + length) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (static_cast<std::size_t>(end - cursor) < sizeof(T)) return false;
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+    bool getString(std::string& value) {
+        std::uint32_t length;
+        if (!get(length) || static_cast<std::size_t>(end - cursor) < length) return false;
+        value.assign(cursor, length);
+        cursor += length;
+        return true;
+    }
+    // Points data at the next length bytes without copying them
+    bool getBytes(const char*& data, std::size_t length) {
+        if (static_cast<std::size_t>(end - cursor) < length) return false;
+        data = cursor;
+        cursor += length;
+        return true;
+    }
+
+private:
+    const char* cursor;
+    const char* end;
+};
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+/**
+ * @class DurableFile
+ * @brief Write-only file handle with an explicit flush to stable storage.
+ */
+class DurableFile {
+public:
+    DurableFile() = default;
+    DurableFile(const DurableFile&) = delete;
+    DurableFile& operator=(const DurableFile&) = delete;
+    ~DurableFile() { close(); }
+
+    bool open(const std::string& path, bool truncate);
+    bool write(const char* data, std::size_t length);
+    bool sync();
+    void close();
+
+private:
+    int fd = -1;
+};
+
+bool DurableFile::open(const std::string& path, bool truncate) {
+    close();
+#ifdef _WIN32
+    int flags = _O_WRONLY | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : _O_APPEND);
+    fd = _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_WRONLY | O_CREAT | (truncate ? O_TRUNC : O_APPEND);
+    fd = ::open(path.c_str(), flags, 0644);
+#endif
+    return fd >= 0;
+}
+
+bool DurableFile::write(const char* data, std::size_t length) {
+    while (length > 0) {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned int>(length));
+#else
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+#endif
+        if (written <= 0) return false;
+        data += written;
+        length -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+bool DurableFile::sync() {
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+}
+
+void DurableFile::close() {
+    if (fd < 0) return;
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+    fd = -1;
+}
+
+// Makes a completed rename durable; a no-op where directories can't be synced
+void syncDirectory(const std::string& dir) {
+#ifndef _WIN32
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)dir;
+#endif
+}
+
+// Whether a snapshot or journal could be loaded, and if not, why. A file
+// written by another format version is refused rather than read as empty.
+enum class LoadStatus { Ok, Corrupt, UnsupportedVersion };
+
+/**
+ * @class WriteAheadLog
+ * @brief Append-only, group-committed journal of state changes.
+ * Writers frame their record into a shared pending buffer and get back a
+ * log sequence number (LSN). One flusher thread writes everything that has
+ * accumulated and issues a single fsync for the whole batch, so concurrent
+ * bookings share each disk flush rather than paying one apiece.
+ *
+ * File layout: [u32 magic][u32 version][u64 generation] followed by records framed as
+ * [u32 length][u32 crc32][payload]. Replay stops at the first torn record.
+ * A header that does not match fails replay, so the file is kept.
+ */
+class WriteAheadLog {
+public:
+    static constexpr std::uint32_t kMagic = 0x4C574152; // "RAWL"
+    static constexpr std::uint32_t kVersion = 9;        // Bumped when record encodings change
+
+    WriteAheadLog();
+    ~WriteAheadLog();
+
+    bool rotate(const std::string& path, std::uint64_t generation); // Start a new file
+    std::uint64_t append(const std::string& payload);
+    bool waitDurable(std::uint64_t lsn); // false if the batch failed to reach disk
+    std::uint64_t recordsInFile() const;
+
+    // Counts the records fed to apply in applied
+    static LoadStatus replay(const std::string& path, std::uint64_t generation,
+                             const std::function<bool(BinaryReader&)>& apply, std::size_t& applied);
+
+private:
+    DurableFile file;
+    mutable std::mutex mutex;
+    std::condition_variable pendingCv;
+    std::condition_variable durableCv;
+    std::string pending;
+    std::uint64_t lastLsn = 0;    // Highest LSN handed out
+    std::uint64_t durableLsn = 0; // Highest LSN known to be on disk
+    std::uint64_t records = 0;    // Records appended to the current file
+    bool flushing = false;
+    bool failed = false;
+    bool stopping = false;
+    std::thread flusher;
+
+    void flushLoop();
+};
+
+WriteAheadLog::WriteAheadLog() : flusher(&WriteAheadLog::flushLoop, this) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    pendingCv.notify_one();
+    flusher.join();
+}
+
+// Drains the current file, then switches to a fresh one. Callers must stop
+// appends while this runs so each record lands in the right generation.
+bool WriteAheadLog::rotate(const std::string& path, std::uint64_t generation) {
+    std::unique_lock<std::mutex> lock(mutex);
+    durableCv.wait(lock, [this] { return pending.empty() && !flushing; });
+
+    BinaryWriter header;
+    header.put(kMagic);
+    header.put(kVersion);
+    header.put(generation);
+    records = 0;
+    return file.open(path, true) && file.write(header.data().data(), header.data().size()) &&
+           file.sync();
+}
+
+std::uint64_t WriteAheadLog::append(const std::string& payload) {
+    BinaryWriter frame;
+    frame.put(static_cast<std::uint32_t>(payload.size()));
+    frame.put(crc32(payload.data(), payload.size()));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending += frame.data();
+    pending += payload;
+    ++records;
+    pendingCv.notify_one();
+    return ++lastLsn;
+}
+
+bool WriteAheadLog::waitDurable(std::uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    durableCv.wait(lock, [this, lsn] { return durableLsn >= lsn; });
+    return !failed;
+}
+
+std::uint64_t WriteAheadLog::recordsInFile() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+// Whatever piles up while one batch is being synced becomes the next batch
+void WriteAheadLog::flushLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        pendingCv.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) return; // Stopping with nothing left to write
+
+        std::string batch;
+        batch.swap(pending);
+        std::uint64_t batchEnd = lastLsn;
+        flushing = true;
+        lock.unlock();
+        bool ok = file.write(batch.data(), batch.size()) && file.sync();
+        lock.lock();
+        flushing = false;
+        if (!ok && !failed) {
+            failed = true;
+            std::cerr << "\n❌ Journal write failed; recent changes may not survive a restart." << std::endl;
+        }
+        durableLsn = batchEnd;
+        durableCv.notify_all();
+    }
+}
+
+// Feeds each intact record of a journal file to apply. The header is
+// synced before any record is appended, so a file too short to hold one
+// was cut off by a crash in rotate and has nothing to replay.
+LoadStatus WriteAheadLog::replay(const std::string& path, std::uint64_t generation,
+                                 const std::function<bool(BinaryReader&)>& apply, std::size_t& applied) {
+    applied = 0;
+    std::string contents;
+    if (!readFile(path, contents)) return LoadStatus::Corrupt;
+    constexpr std::size_t kHeaderSize = 2 * sizeof(std::uint32_t) + sizeof(std::uint64_t);
+    if (contents.size() < kHeaderSize) return LoadStatus::Ok;
+    BinaryReader in(contents.data(), contents.size());
+    std::uint32_t magic, version;
+    std::uint64_t fileGeneration;
+    in.get(magic);
+    in.get(version);
+    in.get(fileGeneration);
+    if (magic != kMagic) return LoadStatus::Corrupt;
+    if (version != kVersion) return LoadStatus::UnsupportedVersion;
+    if (fileGeneration != generation) return LoadStatus::Corrupt;
+
+    while (true) {
+        std::uint32_t length, checksum;
+        const char* payload;
+        if (!in.get(length) || !in.get(checksum) || !in.getBytes(payload, length)) break; // Torn tail
+        if (crc32(payload, length) != checksum) break; // Corrupt record
+        BinaryReader record(payload, length);
+        if (!apply(record)) break;
+        ++applied;
+    }
+    return LoadStatus::Ok;
+}
+
+/**
+ * @class TimetableImage
+ * @brief Read-only, memory-mapped binary timetable: the published train
+ * catalog in a fixed layout that needs no parsing.
+ *
+ * Layout (native byte order), versioned through the header:
+ *   Header   magic "RTTB", version, trainCount, stringBytes, crc32 of the rest
+ *   Records  trainCount packed Record structs, sorted by train number
+ *   Strings  NUL-terminated names, stations and stop lists, addressed by byte offset
+ * Records can be searched in place with find(), and strings are read
+ * straight out of the mapping.
+ */
+class TimetableImage {
+public:
+    static constexpr std::uint32_t kMagic = 0x42545452; // "RTTB"
+    static constexpr std::uint32_t kVersion = 3;
+
+    struct Header {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t trainCount;
+        std::uint32_t stringBytes;
+        std::uint32_t checksum;
+        std::uint32_t reserved;
+    };
+
+    struct Record {
+        std::int32_t trainNumber;
+        std::uint32_t name;        // Offsets into the string table
+        std::uint32_t source;
+        std::uint32_t destination;
+        std::int64_t fare;         // Paise
+        std::int32_t totalSeats;
+        std::uint32_t stops;       // Intermediate stations joined by kStopSeparator
+    };
+
+    static constexpr char kStopSeparator = '|';
+
+    TimetableImage() = default;
+    TimetableImage(const TimetableImage&) = delete;
+    TimetableImage& operator=(const TimetableImage&) = delete;
+    ~TimetableImage() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+    std::size_t size() const { return header ? header->trainCount : 0; }
+    const Record& record(std::size_t i) const { return records[i]; }
+    const Record* find(int trainNumber) const;
+    const char* text(std::uint32_t offset) const { return strings + offset; }
+
+    static bool write(const std::string& path, const std::deque<Train>& trains);
+
+private:
+    const char* base = nullptr;
+    std::size_t length = 0;
+    std::string fallback; // File contents where mmap is unavailable
+    const Header* header = nullptr;
+    const Record* records = nullptr;
+    const char* strings = nullptr;
+};
+
+bool TimetableImage::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    if (!readFile(path, fallback)) return false;
+    base = fallback.data();
+    length = fallback.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        length = 0;
+        return false;
+    }
+    base = static_cast<const char*>(mapped);
+#endif
+
+    // Validate before trusting any offset in the file
+    const Header* h = reinterpret_cast<const Header*>(base);
+    std::size_t recordBytes = length >= sizeof(Header) ? std::size_t(h->trainCount) * sizeof(Record) : 0;
+    if (length < sizeof(Header) || h->magic != kMagic || h->version != kVersion ||
+        length != sizeof(Header) + recordBytes + h->stringBytes ||
+        crc32(base + sizeof(Header), length - sizeof(Header)) != h->checksum) {
+        close();
+        return false;
+    }
+    header = h;
+    records = reinterpret_cast<const Record*>(base + sizeof(Header));
+    strings = base + sizeof(Header) + recordBytes;
+    bool valid = h->stringBytes == 0 ? h->trainCount == 0 : strings[h->stringBytes - 1] == '\0';
+    for (std::size_t i = 0; valid && i < size(); ++i) {
+        const Record& r = records[i];
+        valid = r.name < h->stringBytes && r.source < h->stringBytes && r.destination < h->stringBytes &&
+                r.stops < h->stringBytes;
+    }
+    if (!valid) close();
+    return valid;
+}
+
+void TimetableImage::close() {
+#ifndef _WIN32
+    if (base) ::munmap(const_cast<char*>(base), length);
+#endif
+    fallback.clear();
+    base = nullptr;
+    length = 0;
+    header = nullptr;
+    records = nullptr;
+    strings = nullptr;
+}
+
+// Binary search over the sorted records, without loading the catalog
+const TimetableImage::Record* TimetableImage::find(int trainNumber) const {
+    const Record* end = records + size();
+    const Record* it = std::lower_bound(records, end, trainNumber,
+        [](const Record& r, int number) { return r.trainNumber < number; });
+    return it != end && it->trainNumber == trainNumber ? it : nullptr;
+}
+
+// Writes trains as a new image, atomically replacing any file at path
+bool TimetableImage::write(const std::string& path, const std::deque<Train>& trains) {
+    std::vector<const Train*> sorted;
+    sorted.reserve(trains.size());
+    for (const Train& train : trains) sorted.push_back(&train);
+    std::sort(sorted.begin(), sorted.end(),
+        [](const Train* a, const Train* b) { return a->trainNumber < b->trainNumber; });
+
+    std::string table;
+    std::unordered_map<std::string, std::uint32_t> offsets; // Stations repeat a lot
+    auto intern = [&table, &offsets](const std::string& value) {
+        auto it = offsets.find(value);
+        if (it != offsets.end()) return it->second;
+        std::uint32_t offset = static_cast<std::uint32_t>(table.size());
+        table.append(value).push_back('\0');
+        offsets.emplace(value, offset);
+        return offset;
+    };
+
+    std::vector<Record> out;
+    out.reserve(sorted.size());
+    for (const Train* train : sorted) {
+        Record r{};
+        r.trainNumber = train->trainNumber;
+        r.name = intern(train->trainName());
+        r.source = intern(train->source());
+        r.destination = intern(train->destination());
+        r.fare = train->fare.load();
+        r.totalSeats = train->totalSeats.load();
+        std::string stops;
+        for (int i = 1; i < train->segments(); ++i) {
+            if (!stops.empty()) stops.push_back(kStopSeparator);
+            stops += train->stationName(i);
+        }
+        r.stops = intern(stops);
+        out.push_back(r);
+    }
+
+    std::string body(reinterpret_cast<const char*>(out.data()), out.size() * sizeof(Record));
+    body += table;
+    Header h{};
+    h.magic = kMagic;
+    h.version = kVersion;
+    h.trainCount = static_cast<std::uint32_t>(out.size());
+    h.stringBytes = static_cast<std::uint32_t>(table.size());
+    h.checksum = crc32(body.data(), body.size());
+
+    std::string temp = path + ".tmp";
+    DurableFile file;
+    bool ok = file.open(temp, true) && file.write(reinterpret_cast<const char*>(&h), sizeof(h)) &&
+              file.write(body.data(), body.size()) && file.sync();
+    file.close();
+    return ok && std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+// Kinds of journal record; the first byte of every payload
+enum class JournalEvent : std::uint8_t {
+    AddTrain = 1,
+    SetFare,
+    SetSeats,
+    RegisterUser,
+    Book,
+    Cancel,
+    Promote,
+    CancelRuns
+};
+
+// --- Record encodings shared by journal events and snapshots ---
+
+void writeTrain(BinaryWriter& out, const Train& train) {
+    out.put<std::int32_t>(train.trainNumber);
+    out.putString(train.trainName());
+    out.putString(train.source());
+    out.putString(train.destination());
+    out.put<std::int64_t>(train.fare.load());
+    out.put<std::int32_t>(train.totalSeats.load());
+    out.put(static_cast<std::uint32_t>(train.stopIds.size()));
+    for (NameId stop : train.stopIds) out.putString(NamePool::instance().text(stop));
+}
+
+std::optional<Train> readTrain(BinaryReader& in) {
+    std::int32_t number, total;
+    std::uint32_t stopCount;
+    std::string name, src, dest;
+    std::int64_t fare;
+    if (!in.get(number) || !in.getString(name) || !in.getString(src) || !in.getString(dest) ||
+        !in.get(fare) || !in.get(total) || !in.get(stopCount)) {
+        return std::nullopt;
+    }
+    std::vector<std::string> stops;
+    for (std::uint32_t i = 0; i < stopCount; ++i) {
+        std::string stop;
+        if (!in.getString(stop)) return std::nullopt;
+        stops.push_back(std::move(stop));
+    }
+    // Seats come back free; sales are restored from the tickets that hold them
+    return std::optional<Train>(std::in_place, number, name, src, dest, fare, total, std::move(stops));
+}
+
+void writeTicket(BinaryWriter& out, const Ticket& ticket) {
+    out.put(ticket.pnr);
+    out.put(ticket.train);
+    out.put<std::int32_t>(ticket.trainNumber);
+    out.put(ticket.quota);
+    out.putString(ticket.bookedByUsername());
+    out.put<std::int32_t>(ticket.travelDate);
+    out.put<std::uint16_t>(static_cast<std::uint16_t>(ticket.fromStation));
+    out.put<std::uint16_t>(static_cast<std::uint16_t>(ticket.toStation));
+    out.put(ticket.status);
+    out.put(ticket.waitSeq);
+    out.put(static_cast<std::uint32_t>(ticket.passengers.size()));
+    for (std::size_t i = 0; i < ticket.passengers.size(); ++i) {
+        const Passenger& p = ticket.passengers[i];
+        out.putString(p.name);
+        out.put<std::int32_t>(p.age);
+        out.put(p.gender);
+        out.put<std::int64_t>(p.fare);
+        out.put<std::int32_t>(i < ticket.seats.size() ? ticket.seats[i] : -1); // -1 while waiting
+    }
+}
+
+std::optional<Ticket> readTicket(BinaryReader& in) {
+    Pnr pnr;
+    TrainHandle handle;
+    std::int32_t trainNumber;
+    Quota quota;
+    std::string username;
+    std::int32_t date;
+    std::uint16_t from, to;
+    TicketStatus status;
+    std::uint64_t waitSeq;
+    std::uint32_t count;
+    if (!in.get(pnr) || !in.get(handle) || !in.get(trainNumber) || !in.get(quota) ||
+        quota > Quota::Tatkal || !in.getString(username) || !in.get(date) || !in.get(from) || !in.get(to) || !in.get(status) ||
+        status > TicketStatus::Waiting || !in.get(waitSeq) || !in.get(count)) {
+        return std::nullopt;
+    }
+    PassengerList passengers(count);
+    SeatList seats(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+        Passenger& p = passengers[i];
+        std::int32_t age, seat;
+        if (!in.getString(p.name) || !in.get(age) || !in.get(p.gender) || !in.get(p.fare) || !in.get(seat)) {
+            return std::nullopt;
+        }
+        p.age = age;
+        seats[i] = seat;
+    }
+    std::optional<Ticket> ticket(std::in_place, pnr, handle, trainNumber, NamePool::instance().intern(username),
+                                 std::move(passengers));
+    ticket->quota = quota;
+    ticket->travelDate = date;
+    ticket->fromStation = from;
+    ticket->toStation = to;
+    ticket->status = status;
+    ticket->waitSeq = waitSeq;
+    if (status == TicketStatus::Confirmed) ticket->seats = std::move(seats);
+    return ticket;
+}
+
+// =====================================================================
+// METRICS
+// =====================================================================
+
+#if RAILWAY_METRICS
+
+/**
+ * @class MetricCounter
+ * @brief Monotonic event count, one cache line per stripe of threads.
+ * Adding is a relaxed increment on the caller's own stripe; reading sums
+ * the stripes, so it is meant for scrapes rather than the hot path.
+ */
+class MetricCounter {
+public:
+    void add(std::uint64_t count = 1) { stripes[counterStripe()].value.fetch_add(count, std::memory_order_relaxed); }
+    std::uint64_t value() const;
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<std::uint64_t> value{0};
+    };
+    std::array<Stripe, kCounterStripes> stripes;
+};
+
+std::uint64_t MetricCounter::value() const {
+    std::uint64_t total = 0;
+    for (const Stripe& stripe : stripes) total += stripe.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+/**
+ * @class LatencyHistogram
+ * @brief HDR-style latency histogram in nanoseconds: exact below 64 ns,
+ * then 32 linear sub-buckets per power of two, so every recorded value is
+ * kept within about 3% up to 2^36 ns (68 s). Recording is an index
+ * computation and one relaxed increment on the caller's stripe; a
+ * snapshot merges the stripes for quantiles and export.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 5;
+    static constexpr int kMaxBits = 36; // Longer values are clamped
+    static constexpr std::size_t kBuckets = (std::size_t(2) << kSubBits) + (kMaxBits - kSubBits - 1) * (std::size_t(1) << kSubBits);
+
+    struct Snapshot {
+        std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(kBuckets, 0);
+        std::uint64_t total = 0;
+        std::uint64_t sum = 0; // Nanoseconds
+        std::uint64_t quantile(double q) const; // Upper bound of the bucket holding it
+        std::uint64_t atOrBelow(std::uint64_t nanos) const;
+        Snapshot since(const Snapshot& earlier) const; // What was recorded in between
+    };
+
+    void record(std::uint64_t nanos, std::uint64_t times = 1);
+    Snapshot snapshot() const;
+    static std::size_t bucketOf(std::uint64_t nanos);
+    static std::uint64_t upperBound(std::size_t bucket); // Largest value counted in bucket
+
+private:
+    struct alignas(64) Stripe {
+        std::array<std::atomic<std::uint64_t>, kBuckets> counts{};
+        std::atomic<std::uint64_t> sum{0};
+    };
+    std::array<Stripe, kCounterStripes> stripes;
+};
+
+std::size_t LatencyHistogram::bucketOf(std::uint64_t nanos) {
+    constexpr std::uint64_t linear = std::uint64_t(2) << kSubBits;
+    nanos = std::min(nanos, (std::uint64_t(1) << kMaxBits) - 1);
+    if (nanos < linear) return static_cast<std::size_t>(nanos);
+    int shift = highestBit64(nanos) - kSubBits;
+    std::uint64_t sub = (nanos >> shift) - (std::uint64_t(1) << kSubBits);
+    return static_cast<std::size_t>(linear + (shift - 1) * (std::uint64_t(1) << kSubBits) + sub);
+}
+
+std::uint64_t LatencyHistogram::upperBound(std::size_t bucket) {
+    constexpr std::size_t linear = std::size_t(2) << kSubBits;
+    if (bucket < linear) return bucket;
+    std::size_t offset = bucket - linear;
+    int shift = static_cast<int>(offset >> kSubBits) + 1;
+    std::uint64_t sub = (offset & ((std::size_t(1) << kSubBits) - 1)) + (std::uint64_t(1) << kSubBits);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t nanos, std::uint64_t times) {
+    Stripe& stripe = stripes[counterStripe()];
+    stripe.counts[bucketOf(nanos)].fetch_add(times, std::memory_order_relaxed);
+    stripe.sum.fetch_add(nanos * times, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot merged;
+    for (const Stripe& stripe : stripes) {
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            std::uint64_t count = stripe.counts[i].load(std::memory_order_relaxed);
+            merged.counts[i] += count;
+            merged.total += count;
+        }
+        merged.sum += stripe.sum.load(std::memory_order_relaxed);
+    }
+    return merged;
+}
+
+std::uint64_t LatencyHistogram::Snapshot::quantile(double q) const {
+    if (total == 0) return 0;
+    std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= std::max<std::uint64_t>(1, rank)) return upperBound(i);
+    }
+    return upperBound(counts.size() - 1);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot& earlier) const {
+    Snapshot interval = *this;
+    for (std::size_t i = 0; i < counts.size(); ++i) interval.counts[i] -= earlier.counts[i];
+    interval.total -= earlier.total;
+    interval.sum -= earlier.sum;
+    return interval;
+}
+
+std::uint64_t LatencyHistogram::Snapshot::atOrBelow(std::uint64_t nanos) const {
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size() && upperBound(i) <= nanos; ++i) seen += counts[i];
+    return seen;
+}
+
+// Times its scope into a histogram, as that many operations of the same latency
+class LatencyTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+    explicit LatencyTimer(LatencyHistogram& target, std::uint64_t operations = 1)
+        : histogram(target), times(operations), start(Clock::now()) {}
+    ~LatencyTimer() { histogram.record(elapsed(), times); }
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+    std::uint64_t elapsed() const {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+private:
+    LatencyHistogram& histogram;
+    std::uint64_t times;
+    Clock::time_point start;
+};
+
+#else // Compiled out: the same interface, with nothing stored and nothing timed
+
+class MetricCounter {
+public:
+    void add(std::uint64_t = 1) {}
+    std::uint64_t value() const { return 0; }
+};
+
+class LatencyHistogram {
+public:
+    struct Snapshot {
+        std::uint64_t total = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t quantile(double) const { return 0; }
+        std::uint64_t atOrBelow(std::uint64_t) const { return 0; }
+        Snapshot since(const Snapshot&) const { return Snapshot(); }
+    };
+    void record(std::uint64_t, std::uint64_t = 1) {}
+    Snapshot snapshot() const { return Snapshot(); }
+};
+
+class LatencyTimer {
+public:
+    explicit LatencyTimer(LatencyHistogram&, std::uint64_t = 1) {}
+    std::uint64_t elapsed() const { return 0; }
+};
+
+#endif // RAILWAY_METRICS
+
+/**
+ * @class RailwayMetrics
+ * @brief Instruments of the booking core: a latency histogram per
+ * operation and outcome counters, PNR retries among them. Gauges such as
+ * seat occupancy are not kept here; they are read from the live state
+ * when metrics are exported, so they cost nothing in between.
+ */
+struct RailwayMetrics {
+    enum Operation {
+        Book,
+        Cancel,
+        GeneratePnr,
+        Login, // Includes the password KDF
+        SessionResume,
+        SeatLookup,
+        TicketLookup,
+        TrainListing,
+        JourneySearch,
+        kOperations
+    };
+    static constexpr std::array<const char*, kOperations> kNames = {
+        "book", "cancel", "generate_pnr", "login", "session_resume",
+        "seat_lookup", "ticket_lookup", "train_listing", "journey_search"};
+
+    std::array<LatencyHistogram, kOperations> latency;
+    MetricCounter booked, waitlisted, bookingsRefused;
+    MetricCounter cancelled, cancelsRefused;
+    MetricCounter loginsFailed;
+    MetricCounter pnrRetries; // Allocated PNRs already in use; non-zero once the counter wraps
+
+    // Alerts are judged over the interval between scrapes
+    static constexpr std::uint64_t kBookingP99Alert = 50'000'000; // Nanoseconds
+
+    LatencyHistogram& operator[](Operation op) { return latency[op]; }
+};
+
+// Latency bucket bounds exported to scrapers, in seconds; quantiles use the full histogram
+constexpr std::array<double, 19> kExportedLatencyBounds = {
+    1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3,
+    2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 1, 5};
+
+// =====================================================================
+// REQUEST SCHEDULER
+// =====================================================================
+
+/**
+ * @class RequestScheduler
+ * @brief Work-stealing thread pool for booking, cancellation and listing
+ * requests.
+ * Every worker has a deque of its own. It pops its own tasks from the back
+ * (newest first, while they are cache-warm), and an idle worker steals the
+ * oldest task from the front of someone else's deque. Sharded tasks are
+ * different: they go to a per-worker mailbox that is never stolen, so all
+ * tasks for one shard (a train) run one at a time, in order, on one
+ * worker. parallelFor fans a cross-train query out over all workers, and
+ * the calling thread joins in rather than blocking.
+ */
+class RequestScheduler {
+public:
+    using Task = std::function<void()>;
+
+    struct Stats {
+        std::size_t workers = 0;
+        std::uint64_t executed = 0;
+        std::uint64_t stolen = 0;     // Tasks run by a worker other than the one queued on
+        std::uint64_t sharded = 0;    // Tasks submitted through submitTo
+        std::vector<std::size_t> depth; // Tasks waiting, per worker
+    };
+
+    explicit RequestScheduler(unsigned workerCount = std::thread::hardware_concurrency());
+    ~RequestScheduler(); // Runs everything already queued, then joins
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    void submit(Task task);                        // Any worker; may be stolen
+    void submitTo(std::uint64_t shard, Task task); // Always worker shard % workers, in order
+    // Runs body(0..count-1) across the pool and returns when all are done
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+    void wait(); // Until nothing is queued or running
+    std::size_t workers() const { return pool.size(); }
+    Stats stats() const;
+
+private:
+    struct alignas(64) Worker {
+        mutable std::mutex mutex;  // Guards both queues
+        std::deque<Task> local;    // Owner takes the back, thieves the front
+        std::deque<Task> sharded;  // Owner only, FIFO
+        std::atomic<std::size_t> shardedWaiting{0};
+        std::atomic<std::uint64_t> executed{0};
+        std::atomic<std::uint64_t> stolen{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> pool;
+    std::vector<std::thread> threads;
+    std::mutex idleMutex;            // Sleeping and waking; counts only rise under it
+    std::condition_variable idle;    // Workers wait here for work
+    std::condition_variable drained; // wait() waits here
+    std::atomic<std::size_t> stealable{0}; // Tasks across all local deques
+    std::atomic<std::size_t> unfinished{0}; // Queued or running
+    std::atomic<std::size_t> nextWorker{0}; // Round robin for outside submitters
+    std::atomic<std::uint64_t> shardedTotal{0};
+    bool stopping = false;
+
+    static thread_local const RequestScheduler* currentPool;
+    static thread_local std::size_t currentWorker;
+
+    void workerLoop(std::size_t self);
+    bool runOne(std::size_t self); // False if there was nothing to run
+    void finished();
+};
+
+thread_local const RequestScheduler* RequestScheduler::currentPool = nullptr;
+thread_local std::size_t RequestScheduler::currentWorker = 0;
+
+RequestScheduler::RequestScheduler(unsigned workerCount) {
+    std::size_t count = std::max(1u, workerCount);
+    for (std::size_t i = 0; i < count; ++i) pool.push_back(std::make_unique<Worker>());
+    for (std::size_t i = 0; i < count; ++i) threads.emplace_back(&RequestScheduler::workerLoop, this, i);
+}
+
+RequestScheduler::~RequestScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+// From a worker, the task goes on that worker's own deque
+void RequestScheduler::submit(Task task) {
+    std::size_t target = currentPool == this ? currentWorker : nextWorker++ % pool.size();
+    unfinished++;
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stealable++; // Counted before it is visible, so the count never runs below the deques
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool[target]->mutex);
+        pool[target]->local.push_back(std::move(task));
+    }
+    idle.notify_one();
+}
+
+void RequestScheduler::submitTo(std::uint64_t shard, Task task) {
+    Worker& worker = *pool[shard % pool.size()];
+    unfinished++;
+    shardedTotal++;
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        worker.shardedWaiting++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.sharded.push_back(std::move(task));
+    }
+    idle.notify_all(); // Only one worker can take it, and notify_one might pick another
+}
+
+// Indexes are claimed from a shared counter, so the caller and any helpers
+// that start in time split the range; helpers that start late find nothing
+// left. Because the caller works instead of waiting, this cannot deadlock
+// even when every worker is busy, or when called from a worker.
+void RequestScheduler::parallelFor(std::size_t count, const std::function<void(std::size_t)>& body) {
+    struct Range {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable complete;
+    };
+    auto range = std::make_shared<Range>();
+    auto work = [range, count, &body] {
+        std::size_t finishedHere = 0;
+        for (std::size_t i; (i = range->next++) < count; ++finishedHere) body(i);
+        if (finishedHere > 0 && range->done.fetch_add(finishedHere) + finishedHere == count) {
+            std::lock_guard<std::mutex> lock(range->mutex);
+            range->complete.notify_all();
+        }
+    };
+    std::size_t helpers = std::min(count, pool.size()) - (count > 0 ? 1 : 0);
+    for (std::size_t i = 0; i < helpers; ++i) submit(work);
+    work();
+    std::unique_lock<std::mutex> lock(range->mutex);
+    range->complete.wait(lock, [&] { return range->done.load() == count; });
+}
+
+void RequestScheduler::wait() {
+    std::unique_lock<std::mutex> lock(idleMutex);
+    drained.wait(lock, [this] { return unfinished.load() == 0; });
+}
+
+RequestScheduler::Stats RequestScheduler::stats() const {
+    Stats result;
+    result.workers = pool.size();
+    result.sharded = shardedTotal.load();
+    for (const auto& worker : pool) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        result.executed += worker->executed.load();
+        result.stolen += worker->stolen.load();
+        result.depth.push_back(worker->local.size() + worker->sharded.size());
+    }
+    return result;
+}
+
+void RequestScheduler::workerLoop(std::size_t self) {
+    currentPool = this;
+    currentWorker = self;
+    Worker& worker = *pool[self];
+    while (true) {
+        if (runOne(self)) continue;
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idle.wait(lock, [&] { return stopping || stealable.load() > 0 || worker.shardedWaiting.load() > 0; });
+        if (stopping && stealable.load() == 0 && worker.shardedWaiting.load() == 0) return;
+    }
+}
+
+// Own mailbox first, to keep a shard's queue short, then own deque, then steal
+bool RequestScheduler::runOne(std::size_t self) {
+    Worker& worker = *pool[self];
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.sharded.empty()) {
+            task = std::move(worker.sharded.front());
+            worker.sharded.pop_front();
+            worker.shardedWaiting--;
+        } else if (!worker.local.empty()) {
+            task = std::move(worker.local.back());
+            worker.local.pop_back();
+            stealable--;
+        }
+    }
+    for (std::size_t i = 1; !task && i < pool.size(); ++i) {
+        Worker& victim = *pool[(self + i) % pool.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.local.empty()) {
+            task = std::move(victim.local.front());
+            victim.local.pop_front();
+            stealable--;
+            worker.stolen++;
+        }
+    }
+    if (!task) return false;
+    task();
+    worker.executed++;
+    finished();
+    return true;
+}
+
+void RequestScheduler::finished() {
+    if (--unfinished == 0) {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        drained.notify_all();
+    }
+}
+
+// =====================================================================
+// AUTHENTICATION
+// =====================================================================
+
+/**
+ * @class Sha256
+ * @brief Incremental SHA-256 (FIPS 180-4), the primitive under the
+ * password KDF. A hasher can be copied part-way through, which lets HMAC
+ * key its inner and outer pads once instead of once per block.
+ */
+class Sha256 {
+public:
+    static constexpr std::size_t kDigestBytes = 32;
+    static constexpr std::size_t kBlockBytes = 64;
+    using Digest = std::array<std::uint8_t, kDigestBytes>;
+
+    void update(const void* data, std::size_t length);
+    Digest finish(); // The hasher is spent afterwards
+
+private:
+    std::array<std::uint32_t, 8> state = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                          0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::array<std::uint8_t, kBlockBytes> block{};
+    std::size_t blockUsed = 0;
+    std::uint64_t totalBytes = 0;
+
+    void compress(const std::uint8_t* chunk);
+};
+
+void Sha256::update(const void* data, std::size_t length) {
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    totalBytes += length;
+    if (blockUsed > 0) {
+        std::size_t take = std::min(length, kBlockBytes - blockUsed);
+        std::memcpy(block.data() + blockUsed, bytes, take);
+        blockUsed += take;
+        bytes += take;
+        length -= take;
+        if (blockUsed < kBlockBytes) return;
+        compress(block.data());
+        blockUsed = 0;
+    }
+    for (; length >= kBlockBytes; bytes += kBlockBytes, length -= kBlockBytes) compress(bytes);
+    std::memcpy(block.data(), bytes, length);
+    blockUsed = length;
+}
+
+Sha256::Digest Sha256::finish() {
+    std::uint64_t bits = totalBytes * 8;
+    std::uint8_t padding[kBlockBytes + 8] = {0x80};
+    std::size_t padLength = (blockUsed < 56 ? 56 : 120) - blockUsed;
+    for (int i = 0; i < 8; ++i) padding[padLength + i] = static_cast<std::uint8_t>(bits >> (56 - 8 * i));
+    update(padding, padLength + 8);
+    Digest digest;
+    for (std::size_t i = 0; i < 8; ++i) {
+        for (std::size_t j = 0; j < 4; ++j) digest[4 * i + j] = static_cast<std::uint8_t>(state[i] >> (24 - 8 * j));
+    }
+    return digest;
+}
+
+void Sha256::compress(const std::uint8_t* chunk) {
+    static const std::uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    auto rotr = [](std::uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+    std::uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = static_cast<std::uint32_t>(chunk[4 * i]) << 24 | static_cast<std::uint32_t>(chunk[4 * i + 1]) << 16 |
+               static_cast<std::uint32_t>(chunk[4 * i + 2]) << 8 | chunk[4 * i + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        std::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        std::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        std::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+/**
+ * @class PasswordHasher
+ * @brief Salted PBKDF2-HMAC-SHA256 credentials with a tunable cost.
+ * A credential is stored as "pbkdf2-sha256$<iterations>$<salt>$<key>"
+ * (hex), so each one carries its own cost and the default can be raised
+ * without invalidating existing accounts. Plain passwords are never
+ * stored or journaled.
+ */
+class PasswordHasher {
+public:
+    static constexpr std::uint32_t kDefaultIterations = 100000;
+    static constexpr std::size_t kSaltBytes = 16;
+
+    static std::string hash(const std::string& password, std::uint32_t iterations);
+    static bool verify(const std::string& password, const std::string& credential);
+    static bool wellFormed(const std::string& credential); // Parses, as when imported
+
+private:
+    static bool parse(const std::string& credential, std::uint32_t& iterations, std::string& salt,
+                      std::string& key);
+    static Sha256::Digest derive(const std::string& password, const std::string& salt, std::uint32_t iterations);
+    static std::string toHex(const std::uint8_t* bytes, std::size_t length);
+    static bool fromHex(const std::string& text, std::string& bytes);
+};
+
+// One 32-byte block of PBKDF2 (RFC 8018), which is all a SHA-256 sized key needs
+Sha256::Digest PasswordHasher::derive(const std::string& password, const std::string& salt, std::uint32_t iterations) {
+    std::array<std::uint8_t, Sha256::kBlockBytes> key{};
+    if (password.size() > Sha256::kBlockBytes) {
+        Sha256 shortened;
+        shortened.update(password.data(), password.size());
+        Sha256::Digest digest = shortened.finish();
+        std::memcpy(key.data(), digest.data(), digest.size());
+    } else {
+        std::memcpy(key.data(), password.data(), password.size());
+    }
+    std::array<std::uint8_t, Sha256::kBlockBytes> innerPad, outerPad;
+    for (std::size_t i = 0; i < key.size(); ++i) {
+        innerPad[i] = key[i] ^ 0x36;
+        outerPad[i] = key[i] ^ 0x5c;
+    }
+    Sha256 inner, outer;
+    inner.update(innerPad.data(), innerPad.size());
+    outer.update(outerPad.data(), outerPad.size());
+    auto hmac = [&inner, &outer](const void* message, std::size_t length) {
+        Sha256 innerHash = inner;
+        innerHash.update(message, length);
+        Sha256::Digest innerDigest = innerHash.finish();
+        Sha256 outerHash = outer;
+        outerHash.update(innerDigest.data(), innerDigest.size());
+        return outerHash.finish();
+    };
+
+    std::string first = salt + std::string("\0\0\0\1", 4); // Block index 1, big-endian
+    Sha256::Digest u = hmac(first.data(), first.size());
+    Sha256::Digest result = u;
+    for (std::uint32_t i = 1; i < iterations; ++i) {
+        u = hmac(u.data(), u.size());
+        for (std::size_t j = 0; j < result.size(); ++j) result[j] ^= u[j];
+    }
+    return result;
+}
+
+std::string PasswordHasher::hash(const std::string& password, std::uint32_t iterations) {
+    iterations = std::max<std::uint32_t>(1, iterations);
+    std::random_device entropy;
+    std::string salt(kSaltBytes, '\0');
+    for (char& byte : salt) byte = static_cast<char>(entropy() & 0xFF);
+    Sha256::Digest key = derive(password, salt, iterations);
+    return "pbkdf2-sha256$" + std::to_string(iterations) + "$" +
+           toHex(reinterpret_cast<const std::uint8_t*>(salt.data()), salt.size()) + "$" + toHex(key.data(), key.size());
+}
+
+bool PasswordHasher::parse(const std::string& credential, std::uint32_t& iterations, std::string& salt,
+                           std::string& key) {
+    static const std::string kScheme = "pbkdf2-sha256$";
+    if (credential.compare(0, kScheme.size(), kScheme) != 0) return false;
+    std::size_t costEnd = credential.find('$', kScheme.size());
+    std::size_t saltEnd = costEnd == std::string::npos ? costEnd : credential.find('$', costEnd + 1);
+    if (saltEnd == std::string::npos) return false;
+    iterations = 0;
+    const char* costBegin = credential.data() + kScheme.size();
+    if (std::from_chars(costBegin, credential.data() + costEnd, iterations).ptr != credential.data() + costEnd ||
+        iterations == 0) {
+        return false;
+    }
+    return fromHex(credential.substr(costEnd + 1, saltEnd - costEnd - 1), salt) &&
+           fromHex(credential.substr(saltEnd + 1), key) && key.size() == Sha256::kDigestBytes;
+}
+
+bool PasswordHasher::wellFormed(const std::string& credential) {
+    std::uint32_t iterations;
+    std::string salt, key;
+    return parse(credential, iterations, salt, key);
+}
+
+// The comparison takes the same time wherever the keys first differ
+bool PasswordHasher::verify(const std::string& password, const std::string& credential) {
+    std::uint32_t iterations;
+    std::string salt, expected;
+    if (!parse(credential, iterations, salt, expected)) return false;
+    Sha256::Digest key = derive(password, salt, iterations);
+    std::uint8_t difference = 0;
+    for (std::size_t i = 0; i < key.size(); ++i) difference |= key[i] ^ static_cast<std::uint8_t>(expected[i]);
+    return difference == 0;
+}
+
+std::string PasswordHasher::toHex(const std::uint8_t* bytes, std::size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(2 * length, '0');
+    for (std::size_t i = 0; i < length; ++i) {
+        text[2 * i] = digits[bytes[i] >> 4];
+        text[2 * i + 1] = digits[bytes[i] & 0xF];
+    }
+    return text;
+}
+
+bool PasswordHasher::fromHex(const std::string& text, std::string& bytes) {
+    if (text.size() % 2 != 0) return false;
+    bytes.resize(text.size() / 2);
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        unsigned value = 0;
+        if (std::from_chars(text.data() + 2 * i, text.data() + 2 * i + 2, value, 16).ptr != text.data() + 2 * i + 2) {
+            return false;
+        }
+        bytes[i] = static_cast<char>(value);
+    }
+    return true;
+}
+
+/**
+ * @class SessionCache
+ * @brief Opaque login tokens, so the KDF runs once per login rather than
+ * once per request.
+ * A token is 128 random bits in hex. Sessions are spread over
+ * independently locked shards, and validating one is a single hash lookup
+ * that also slides its expiry forward. Expired sessions are dropped when
+ * they are next looked up, and each shard is swept every kSweepEvery
+ * logins. Sessions live in memory only and end when the process does.
+ */
+class SessionCache {
+public:
+    static constexpr std::size_t kShards = 16;
+    static constexpr std::size_t kSweepEvery = 1024;
+    using Clock = std::chrono::steady_clock;
+
+    explicit SessionCache(Clock::duration idleTimeout = std::chrono::minutes(30)) : timeout(idleTimeout) {}
+    std::string issue(const std::string& username);
+    std::optional<std::string> validate(const std::string& token); // The session's user, if still live
+    void revoke(const std::string& token);
+
+private:
+    struct Session {
+        std::string username;
+        Clock::time_point expires;
+    };
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Session> sessions;
+        std::size_t issuedSinceSweep = 0;
+    };
+
+    std::array<Shard, kShards> shards;
+    Clock::duration timeout;
+    std::mutex entropyMutex; // std::random_device is not safe to share unlocked
+    std::random_device entropy;
+
+    Shard& shardFor(const std::string& token) { return shards[std::hash<std::string>()(token) % kShards]; }
+};
+
+std::string SessionCache::issue(const std::string& username) {
+    std::string token;
+    {
+        std::lock_guard<std::mutex> lock(entropyMutex);
+        char text[9];
+        for (int i = 0; i < 4; ++i) {
+            std::snprintf(text, sizeof(text), "%08x", static_cast<unsigned>(entropy()));
+            token += text;
+        }
+    }
+    Shard& shard = shardFor(token);
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (++shard.issuedSinceSweep >= kSweepEvery) {
+        shard.issuedSinceSweep = 0;
+        for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+            it = it->second.expires <= now ? shard.sessions.erase(it) : std::next(it);
+        }
+    }
+    shard.sessions[token] = Session{username, now + timeout};
+    return token;
+}
+
+std::optional<std::string> SessionCache::validate(const std::string& token) {
+    Shard& shard = shardFor(token);
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(token);
+    if (it == shard.sessions.end()) return std::nullopt;
+    if (it->second.expires <= now) {
+        shard.sessions.erase(it);
+        return std::nullopt;
+    }
+    it->second.expires = now + timeout;
+    return it->second.username;
+}
+
+void SessionCache::revoke(const std::string& token) {
+    Shard& shard = shardFor(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sessions.erase(token);
+}
+
+// =====================================================================
+// REPORTING
+// =====================================================================
+
+// Which tickets an ad-hoc report or export covers
+struct ReportQuery {
+    int trainNumber = 0; // 0 for every train
+    RunDate firstDate = std::numeric_limits<RunDate>::min();
+    RunDate lastDate = std::numeric_limits<RunDate>::max();
+    bool includeWaiting = true;
+
+    bool covers(const Ticket& ticket) const {
+        return (trainNumber == 0 || ticket.trainNumber == trainNumber) && ticket.travelDate >= firstDate &&
+               ticket.travelDate <= lastDate && (includeWaiting || ticket.status != TicketStatus::Waiting);
+    }
+};
+
+// One train's line of a report
+struct ReportRow {
+    int trainNumber;
+    std::string trainName;
+    TicketAggregates::Values totals;
+    Train::Occupancy occupancy{}; // Filled in by the dashboard only
+};
+
+/**
+ * @class TicketColumns
+ * @brief A batch of tickets projected column-wise for a report scan: the
+ * fields queries filter and sum on, in contiguous arrays, with passengers
+ * flattened into columns of their own. A scan copies one ticket shard in
+ * under the shard's lock, then filters and aggregates with the lock
+ * released, in tight loops over the columns.
+ */
+class TicketColumns {
+public:
+    void clear();
+    void append(const Ticket& ticket);
+    std::size_t size() const { return trains.size(); }
+    // Adds the matching tickets into perTrain, indexed by train handle
+    void aggregate(const ReportQuery& query, TrainHandle only, std::vector<TicketAggregates::Values>& perTrain);
+
+private:
+    std::vector<TrainHandle> trains;
+    std::vector<RunDate> dates;
+    std::vector<std::uint8_t> waiting;
+    std::vector<Paise> farePaise; // Whole ticket
+    std::vector<std::uint32_t> firstPassenger; // Into the passenger columns; one extra at the end
+    std::vector<std::uint8_t> ages;      // Clamped to 255
+    std::vector<std::uint8_t> genders;   // As typed, upper-cased
+    std::vector<std::uint8_t> matches;   // Scratch for aggregate
+};
+
+void TicketColumns::clear() {
+    trains.clear();
+    dates.clear();
+    waiting.clear();
+    farePaise.clear();
+    firstPassenger.assign(1, 0);
+    ages.clear();
+    genders.clear();
+}
+
+void TicketColumns::append(const Ticket& ticket) {
+    if (firstPassenger.empty()) firstPassenger.push_back(0);
+    trains.push_back(ticket.train);
+    dates.push_back(ticket.travelDate);
+    waiting.push_back(ticket.status == TicketStatus::Waiting);
+    farePaise.push_back(ticket.totalFare());
+    for (const Passenger& passenger : ticket.passengers) {
+        ages.push_back(static_cast<std::uint8_t>(std::clamp(passenger.age, 0, 255)));
+        genders.push_back(static_cast<std::uint8_t>(std::toupper(static_cast<unsigned char>(passenger.gender))));
+    }
+    firstPassenger.push_back(static_cast<std::uint32_t>(ages.size()));
+}
+
+// Branch-free filter pass first, like TrainColumns::match, then sums over the matches only
+void TicketColumns::aggregate(const ReportQuery& query, TrainHandle only,
+                              std::vector<TicketAggregates::Values>& perTrain) {
+    using Totals = TicketAggregates;
+    std::size_t count = size();
+    matches.resize(count);
+    bool anyTrain = only == TrainIndex::npos;
+    for (std::size_t i = 0; i < count; ++i) {
+        matches[i] = static_cast<std::uint8_t>((dates[i] >= query.firstDate) & (dates[i] <= query.lastDate) &
+                                               (anyTrain | (trains[i] == only)) &
+                                               (query.includeWaiting | !waiting[i]));
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!matches[i]) continue;
+        Totals::Values& values = perTrain[trains[i]];
+        std::int64_t travellers = firstPassenger[i + 1] - firstPassenger[i];
+        values[Totals::Tickets] += 1;
+        values[Totals::Passengers] += travellers;
+        values[Totals::Waiting] += waiting[i] ? travellers : 0;
+        values[Totals::RevenuePaise] += farePaise[i];
+        for (std::uint32_t p = firstPassenger[i]; p < firstPassenger[i + 1]; ++p) {
+            ++values[genders[p] == 'M' ? Totals::Male : genders[p] == 'F' ? Totals::Female : Totals::OtherGender];
+            ++values[ages[p] < 12   ? Totals::Children
+                     : ages[p] < 18 ? Totals::Youths
+                     : ages[p] < 60 ? Totals::Adults
+                                    : Totals::Seniors];
+        }
+    }
+}
+
+// Quotes a CSV field if it needs it (RFC 4180)
+void writeCsvField(OutputBuffer& out, const std::string& field) {
+    if (field.find_first_of(",\"\r\n") == std::string::npos) {
+        out << field;
+        return;
+    }
+    out << '"';
+    for (char c : field) {
+        if (c == '"') out << '"';
+        out << c;
+    }
+    out << '"';
+}
+
+// Reads the CSV row (RFC 4180) starting at pos into fields and returns
+// where the next row starts; line counts the newlines passed, quoted ones too
+std::size_t readCsvRow(const std::string& text, std::size_t pos, std::vector<std::string>& fields,
+                       std::size_t& line) {
+    fields.clear();
+    fields.emplace_back();
+    bool quoted = false;
+    while (pos < text.size()) {
+        char c = text[pos++];
+        if (quoted) {
+            if (c != '"') {
+                if (c == '\n') ++line;
+                fields.back() += c;
+            } else if (pos < text.size() && text[pos] == '"') {
+                fields.back() += '"'; // An escaped quote
+                ++pos;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else if (c == '\n') {
+            ++line;
+            break;
+        } else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return pos;
+}
+
+/**
+ * @class CsvChunker
+ * @brief Cuts a CSV stream into blocks of whole rows for parallel parsing.
+ * Reads about kBlockBytes at a time and ends each block after the last row
+ * that is complete in it; the rest starts the next block. One scan that
+ * tracks quoting finds that row boundary, so a quoted field holding a
+ * newline is never split across blocks. The file is never held in memory
+ * whole.
+ */
+class CsvChunker {
+public:
+    static constexpr std::size_t kBlockBytes = 1 << 20;
+
+    struct Block {
+        std::string text;
+        std::size_t firstLine = 1; // Line number of its first row
+    };
+
+    explicit CsvChunker(std::istream& in) : in(in) {}
+    bool next(Block& block); // False once the stream is used up
+
+private:
+    std::istream& in;
+    std::string carry;     // Start of a row the previous block cut off
+    std::size_t line = 1;
+};
+
+bool CsvChunker::next(Block& block) {
+    block.text.swap(carry);
+    carry.clear();
+    block.firstLine = line;
+    bool quoted = false;
+    std::size_t scanned = 0;
+    std::size_t cut = std::string::npos;
+    while (in) {
+        std::size_t size = block.text.size();
+        block.text.resize(size + kBlockBytes);
+        in.read(&block.text[size], static_cast<std::streamsize>(kBlockBytes));
+        block.text.resize(size + static_cast<std::size_t>(in.gcount()));
+        for (; scanned < block.text.size(); ++scanned) {
+            char c = block.text[scanned];
+            if (c == '"') quoted = !quoted;
+            else if (c == '\n' && !quoted) cut = scanned + 1;
+        }
+        if (cut != std::string::npos) break;
+    }
+    if (cut == std::string::npos) cut = block.text.size(); // The last row, unterminated
+    carry.assign(block.text, cut, std::string::npos);
+    block.text.resize(cut);
+    line += static_cast<std::size_t>(std::count(block.text.begin(), block.text.end(), '\n'));
+    return !block.text.empty();
+}
+
+// What a bulk import did. Rejected rows are skipped and reported, never
+// fatal; the first kMaxListed of them are listed by line.
+struct ImportResult {
+    static constexpr std::size_t kMaxListed = 1000;
+
+    std::size_t accepted = 0;
+    std::size_t rejected = 0;
+    std::vector<std::pair<std::size_t, std::string>> rejects; // Line and reason
+
+    void reject(std::size_t line, std::string reason);
+    void absorb(ImportResult& other); // Adds another part of the same file's result
+    void render(OutputBuffer& out, const char* what) const;
+};
+
+void ImportResult::reject(std::size_t line, std::string reason) {
+    ++rejected;
+    if (rejects.size() < kMaxListed) rejects.emplace_back(line, std::move(reason));
+}
+
+void ImportResult::absorb(ImportResult& other) {
+    accepted += other.accepted;
+    rejected += other.rejected;
+    for (auto& entry : other.rejects) {
+        if (rejects.size() < kMaxListed) rejects.push_back(std::move(entry));
+    }
+    other = ImportResult();
+}
+
+void ImportResult::render(OutputBuffer& out, const char* what) const {
+    out << "✅ Imported " << accepted << ' ' << what << '.';
+    out.line();
+    if (rejected == 0) return;
+    out << "❌ Rejected " << rejected << " row(s):";
+    out.line();
+    std::vector<std::pair<std::size_t, std::string>> listed = rejects;
+    std::sort(listed.begin(), listed.end());
+    for (const auto& entry : listed) {
+        out << "  line " << entry.first << ": " << entry.second;
+        out.line();
+    }
+    if (rejected > listed.size()) {
+        out << "  ... and " << rejected - listed.size() << " more";
+        out.line();
+    }
+}
+
+// =====================================================================
+// RAILWAY MANAGEMENT SYSTEM
+// =====================================================================
+
+// Outcome of a call into the booking core
+enum class BookingStatus {
+    Booked, Waitlisted, NoSuchTrain, NotEnoughSeats, InvalidRequest, RateLimited, Overloaded,
+    PnrsExhausted, // The train's PNR block is nearly full; see PnrAllocator
+    RunCancelled   // The train doesn't run on that date; see cancelTrainRuns
+};
+
+// One booking as submitted to the booking core; see placeBooking
+struct BookingRequest {
+    int trainNumber = 0;
+    RunDate date = 0;
+    PassengerList passengers;
+    std::string username;
+    std::string from; // Empty for the train's source
+    std::string to;   // Empty for its destination
+    bool joinWaitlist = false;
+    Quota quota = Quota::General;
+};
+
+struct BookingResult {
+    BookingStatus status = BookingStatus::InvalidRequest;
+    Pnr pnr = 0;        // Set when status is Booked or Waitlisted
+    Paise fare = 0;     // Total charged, likewise
+    int seatsLeft = 0;  // Seats remaining on the train after the attempt
+    WaitClass waitClass = WaitClass::Waitlist; // When Waitlisted: the class and place joined
+    int waitPlace = 0;
+};
+
+// What a train-level operation did to the tickets it touched
+struct TrainChangeResult {
+    std::size_t cancelled = 0;  // Tickets cancelled
+    std::size_t passengers = 0; // Travelling on them
+    std::size_t reseated = 0;   // Tickets moved to other seats on the same run
+};
+
+// One train ridden between two stations within a journey search result
+struct JourneyLeg {
+    int trainNumber;
+    std::string trainName;
+    std::string from;
+    std::string to;
+    Paise fare; // For the leg, General quota, before surge and concessions
+};
+
+/**
+ * @class TokenBucket
+ * @brief Allows rate events per second on average and bursts of up to
+ * burst at once. Tokens are refilled lazily, when one is taken.
+ * Not synchronized.
+ */
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A rate of 0 means no limit
+    TokenBucket(double perSecond, double burst, Clock::time_point now)
+        : rate(perSecond), capacity(std::max(1.0, burst)), tokens(capacity), refilled(now) {}
+    bool take(Clock::time_point now);
+    bool full(Clock::time_point now) const; // Idle long enough to be forgotten
+
+private:
+    double rate;
+    double capacity;
+    double tokens;
+    Clock::time_point refilled;
+
+    double available(Clock::time_point now) const;
+};
+
+double TokenBucket::available(Clock::time_point now) const {
+    double elapsed = std::chrono::duration<double>(now - refilled).count();
+    return std::min(capacity, tokens + elapsed * rate);
+}
+
+bool TokenBucket::take(Clock::time_point now) {
+    if (rate <= 0) return true;
+    tokens = available(now);
+    refilled = now;
+    if (tokens < 1) return false;
+    tokens -= 1;
+    return true;
+}
+
+bool TokenBucket::full(Clock::time_point now) const {
+    return rate <= 0 || available(now) >= capacity;
+}
+
+/**
+ * @class BookingAdmission
+ * @brief Admission stage in front of the booking core, for the burst when
+ * a popular train's booking window opens.
+ * Requests queue on their train's lane. One drain task per lane runs on
+ * the lane's scheduler worker. It takes everything queued, up to
+ * kMaxBatch, as a micro-batch, puts it in round-robin order by user, and
+ * applies it as one seat-allocation pass, so acquiring the train's locks
+ * and waiting for the fsync are paid once per batch rather than per
+ * booking. Token buckets cap each user and each train. A request is turned
+ * away rather than queued once its lane holds kMaxQueued, and is shed if
+ * it has waited longer than kMaxQueueDelay, so queueing time stays
+ * bounded however large the burst.
+ */
+class BookingAdmission {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Done = std::function<void(const BookingResult&)>;
+    using Apply = std::function<void(std::vector<BookingRequest>&, std::vector<BookingResult>&)>;
+
+    static constexpr std::size_t kLanes = 256;       // Trains hash onto lanes
+    static constexpr std::size_t kMaxQueued = 8192;  // Per lane
+    static constexpr std::size_t kMaxBatch = 512;
+    static constexpr std::size_t kSweepEvery = 4096; // Admissions between sweeps of a user shard
+    static constexpr double kBurstSeconds = 5;       // Buckets hold this many seconds of their rate
+    static constexpr Clock::duration kMaxQueueDelay = std::chrono::milliseconds(250);
+
+    struct Limits {
+        double userRate = 2;     // Bookings per second per user; 0 for no limit
+        double trainRate = 4000; // Bookings admitted per second per train; 0 for no limit
+    };
+    struct Stats {
+        std::uint64_t admitted = 0;
+        std::uint64_t batches = 0;
+        std::uint64_t rateLimited = 0;
+        std::uint64_t shed = 0; // Turned away with the lane full, or after waiting too long
+    };
+
+    // The scheduler need not be running yet; apply is the booking core's batched entry point
+    BookingAdmission(RequestScheduler& pool, Apply applyBatch) : scheduler(pool), apply(std::move(applyBatch)) {}
+    // Also the scheduler shard, so other work on a train queues behind its bookings
+    static std::size_t lane(int trainNumber) { return static_cast<std::size_t>(trainNumber) % kLanes; }
+    // done runs exactly once, on this thread if the request is refused outright
+    void submit(BookingRequest booking, Done done);
+    void setLimits(const Limits& configured) { limits = configured; } // Before the first submit
+    Stats stats() const;
+
+private:
+    struct Pending {
+        BookingRequest booking;
+        Done done;
+        Clock::time_point arrived;
+        std::size_t round = 0; // Among its user's requests in the batch
+    };
+    struct alignas(64) Lane {
+        std::mutex mutex;
+        std::deque<Pending> queue;
+        bool draining = false; // A drain task is queued or running
+        std::unordered_map<int, TokenBucket> trains;
+    };
+    struct alignas(64) UserShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, TokenBucket> buckets;
+        std::size_t takesSinceSweep = 0;
+    };
+
+    RequestScheduler& scheduler;
+    Apply apply;
+    Limits limits;
+    std::array<Lane, kLanes> lanes;
+    std::array<UserShard, 16> users;
+    std::atomic<std::uint64_t> admitted{0};
+    std::atomic<std::uint64_t> batches{0};
+    std::atomic<std::uint64_t> rateLimited{0};
+    std::atomic<std::uint64_t> shed{0};
+
+    bool takeUserToken(const std::string& username, Clock::time_point now);
+    void drain(std::size_t lane);
+    static void refuse(BookingStatus status, const Done& done);
+};
+
+void BookingAdmission::refuse(BookingStatus status, const Done& done) {
+    BookingResult result;
+    result.status = status;
+    done(result);
+}
+
+// Buckets that have refilled completely say nothing a new bucket wouldn't, so sweeps drop them
+bool BookingAdmission::takeUserToken(const std::string& username, Clock::time_point now) {
+    UserShard& shard = users[std::hash<std::string>()(username) % users.size()];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (++shard.takesSinceSweep >= kSweepEvery) {
+        shard.takesSinceSweep = 0;
+        for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+            it = it->second.full(now) ? shard.buckets.erase(it) : std::next(it);
+        }
+    }
+    auto bucket = shard.buckets.try_emplace(username, limits.userRate, limits.userRate * kBurstSeconds, now).first;
+    return bucket->second.take(now);
+}
+
+void BookingAdmission::submit(BookingRequest booking, Done done) {
+    Clock::time_point now = Clock::now();
+    if (!takeUserToken(booking.username, now)) {
+        ++rateLimited;
+        return refuse(BookingStatus::RateLimited, done);
+    }
+    std::size_t index = lane(booking.trainNumber);
+    Lane& lane = lanes[index];
+    BookingStatus refused = BookingStatus::Booked;
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        TokenBucket& train =
+            lane.trains.try_emplace(booking.trainNumber, limits.trainRate, limits.trainRate * kBurstSeconds, now)
+                .first->second;
+        if (lane.queue.size() >= kMaxQueued) {
+            refused = BookingStatus::Overloaded;
+        } else if (!train.take(now)) {
+            refused = BookingStatus::RateLimited;
+        } else {
+            lane.queue.push_back(Pending{std::move(booking), std::move(done), now});
+            schedule = !lane.draining;
+            lane.draining = true;
+        }
+    }
+    if (refused != BookingStatus::Booked) {
+        ++(refused == BookingStatus::Overloaded ? shed : rateLimited);
+        return refuse(refused, done);
+    }
+    ++admitted;
+    if (schedule) scheduler.submitTo(index, [this, index] { drain(index); });
+}
+
+/*
+ * Within a batch, each user's first request comes before anyone's second,
+ * so one user's pipelined burst can't take every seat before others are
+ * served. The lane stays marked as draining until it is empty; a drain
+ * that leaves work behind requeues itself rather than looping, so other
+ * lanes on the same worker get their turn.
+ */
+void BookingAdmission::drain(std::size_t index) {
+    Lane& lane = lanes[index];
+    std::vector<Pending> batch;
+    {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        std::size_t count = std::min(lane.queue.size(), kMaxBatch);
+        batch.assign(std::make_move_iterator(lane.queue.begin()),
+                     std::make_move_iterator(lane.queue.begin() + static_cast<std::ptrdiff_t>(count)));
+        lane.queue.erase(lane.queue.begin(), lane.queue.begin() + static_cast<std::ptrdiff_t>(count));
+    }
+
+    Clock::time_point now = Clock::now();
+    std::unordered_map<std::string, std::size_t> seen;
+    std::vector<Pending> live;
+    live.reserve(batch.size());
+    for (Pending& pending : batch) {
+        if (now - pending.arrived > kMaxQueueDelay) {
+            ++shed;
+            refuse(BookingStatus::Overloaded, pending.done);
+            continue;
+        }
+        pending.round = seen[pending.booking.username]++;
+        live.push_back(std::move(pending));
+    }
+    std::stable_sort(live.begin(), live.end(),
+                     [](const Pending& a, const Pending& b) { return a.round < b.round; });
+
+    if (!live.empty()) {
+        std::vector<BookingRequest> bookings;
+        bookings.reserve(live.size());
+        for (Pending& pending : live) bookings.push_back(std::move(pending.booking));
+        std::vector<BookingResult> results;
+        apply(bookings, results);
+        ++batches;
+        for (std::size_t i = 0; i < live.size(); ++i) live[i].done(results[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(lane.mutex);
+    if (lane.queue.empty()) {
+        lane.draining = false;
+    } else {
+        scheduler.submitTo(index, [this, index] { drain(index); });
+    }
+}
+
+BookingAdmission::Stats BookingAdmission::stats() const {
+    Stats stats;
+    stats.admitted = admitted.load();
+    stats.batches = batches.load();
+    stats.rateLimited = rateLimited.load();
+    stats.shed = shed.load();
+    return stats;
+}
+
+/**
+ * @class RailwayManager
+ * @brief Main class to manage all railway operations and user interactions.
+ * This class demonstrates Object-Oriented Programming principles by
+ * encapsulating all data and functionalities.
+ */
+class RailwayManager {
+private:
+    std::deque<Train> trains;            // Append-only, and trains never move; a train's position is its TrainHandle.
+    TrainIndex trainIndex;               // Hashed train-number lookup into trains.
+    TrainColumns columns;                // Hot fields of trains, stored column-wise.
+    TrainSortViews sortViews{trains, columns}; // Cached orderings for the train listing.
+    RouteIndex routeIndex;               // Stations and the trains calling at them.
+    std::shared_mutex catalogMutex;      // Shared to book, exclusive to add or modify trains.
+    EpochDomain readEpochs;              // Pins of listings reading published snapshots.
+    std::atomic<std::uint64_t> catalogVersion{0}; // Bumped by every change a listing can see
+    std::atomic<const CatalogSnapshot*> catalogView{nullptr}; // Latest published; may lag catalogVersion
+    std::mutex catalogViewMutex;         // One listing at a time publishes; guards retiredViews.
+    RetireList<std::unique_ptr<const CatalogSnapshot>> retiredViews;
+    TicketStore bookedTickets{readEpochs}; // Striped PNR-keyed store for concurrent booking.
+    PnrAllocator pnrAllocator;           // Unique PNRs in O(1), safe across threads.
+    std::unordered_map<NameId, User> users; // Hashed on the interned username.
+    std::mutex usersMutex;
+    User* currentUser = nullptr;
+    SessionCache sessions;               // Login tokens for headless front ends.
+    std::uint32_t passwordCost = PasswordHasher::kDefaultIterations; // KDF iterations for new credentials.
+    std::atomic<bool> surgePricing{false}; // Fares rise as a leg fills; see FareEngine.
+
+    // Persistence: snapshot plus a journal per generation, in dataDir
+    std::string dataDir;                     // Empty when running purely in memory
+    std::unique_ptr<WriteAheadLog> journal;  // Null when not persisting
+    std::uint64_t generation = 0;            // Generation of the live journal
+    std::atomic<bool> checkpointing{false};
+    std::size_t timetableTrains = 0;         // Leading trains that came from timetable.bin
+    static constexpr std::uint64_t kCheckpointEvery = 50000; // Journal records
+    static constexpr std::uint32_t kSnapshotMagic = 0x504E5352; // "RSNP"
+    std::atomic<RunDate> sweptBefore{0}; // Runs before this date have been evicted
+    static constexpr std::uint32_t kSnapshotVersion = 10;
+    BookingAdmission admission;              // Burst control in front of placeBookings; drains on scheduler
+    RailwayMetrics metrics;                  // Hot-path latencies and counts; gauges are read on export
+    std::mutex scrapeMutex;                  // Guards the state alerts compare against
+    LatencyHistogram::Snapshot lastBookings; // Booking latencies as of the previous scrape
+    std::uint64_t lastPnrRetries = 0;
+    bool bookingAlert = false;
+    bool pnrAlert = false;
+    RequestScheduler scheduler;              // Last, so it stops before the state its tasks use
+
+    Pnr generatePNR(std::size_t shard); // A PNR routed to that ticket store shard
+    void seedData();
+    Train* findTrain(int trainNumber); // Caller holds catalogMutex
+    // The catalog as of now, republished first if it changed; caller pins
+    // readEpochs and must not hold catalogMutex
+    const CatalogSnapshot& catalogSnapshot();
+    // Sorted handles of trains passing filter, at most limit (0 for all)
+    static std::vector<TrainHandle> filteredView(const CatalogSnapshot& catalog, TrainSortKey key,
+                                                 const TrainFilter& filter, std::size_t limit);
+    // Update a train and the columns and views derived from it; caller holds catalogMutex exclusively
+    void setFare(TrainHandle handle, Paise fare);
+    void setCapacity(TrainHandle handle, int seats);
+    void evictPastRuns();
+    // Waiting lists are promoted off the booking path, on the train's scheduler shard
+    void requestPromotion(TrainHandle handle, RunDate date); // Caller holds catalogMutex
+    void promoteWaiting(TrainHandle handle, RunDate date);
+
+    std::string snapshotPath() const;
+    std::string timetablePath() const;
+    bool loadTimetable();
+    // Appends a train read from the image, with the fare and capacity given;
+    // caller holds catalogMutex exclusively and rebuilds the sort views after
+    void appendFromImage(const TimetableImage& image, const TimetableImage::Record& r, Paise fare, int seats);
+    std::string journalPath(std::uint64_t gen) const;
+    bool recover();
+    LoadStatus loadSnapshot(const std::string& contents, std::uint64_t& snapshotGeneration);
+    bool applyJournalRecord(BinaryReader& in);
+    bool restoreTicket(const Ticket& ticket); // Caller has checked its train handle
+    bool checkpoint();
+    void maybeCheckpoint();
+    std::uint64_t logEvent(const BinaryWriter& record); // Caller holds the lock guarding the change
+    void awaitDurable(std::uint64_t lsn);
+    // Bulk import: rows of a CSV stream parsed in parallel, in file order
+    template <typename Row, typename Parse>
+    void parseCsvRows(std::istream& in, const char* header, std::vector<Row>& rows, ImportResult& result,
+                      const Parse& parse);
+    void finishImport(std::uint64_t lsn, const ImportResult& result);
+
+    // Admin functionalities
+    void adminDashboard();
+    void addNewTrain();
+    void viewAllSystemTickets();
+    void modifyTrain();
+    void bulkImport();
+
+    // User functionalities
+    void userDashboard();
+    void viewAndSortTrains();
+    void bookTicket();
+    void viewMyTickets();
+    void cancelTicket();
+    void cancelTrainRun();
+    void reportsMenu();
+    void searchJourneys();
+    bool promptTravelDate(RunDate& date);
+
+public:
+    // State lives in dataDirectory; pass an empty string to run in memory only
+    explicit RailwayManager(std::string dataDirectory = ".",
+                            unsigned workers = std::thread::hardware_concurrency());
+    ~RailwayManager();
+    void run(); // Main application loop
+    bool login();
+    void registerUser();
+
+    // Thread-safe booking core, independent of the console UI
+    // from/to name stations on the train's route; empty means its source/destination.
+    // date must fall within the advance booking window. With joinWaitlist, a
+    // booking that finds no seats waits for them instead of failing. Each
+    // passenger is priced by FareEngine under the quota.
+    BookingResult placeBooking(int trainNumber, RunDate date, PassengerList passengers,
+                               const std::string& username, const std::string& from = "",
+                               const std::string& to = "", bool joinWaitlist = false,
+                               Quota quota = Quota::General);
+    // A micro-batch in one allocation pass; results[i] answers requests[i], whose passengers are moved out
+    void placeBookings(std::vector<BookingRequest>& requests, std::vector<BookingResult>& results);
+    // Through the admission stage: may be batched with other bookings, or refused
+    // as RateLimited or Overloaded. done runs once, possibly on a scheduler worker.
+    void admitBooking(BookingRequest request, BookingAdmission::Done done) {
+        admission.submit(std::move(request), std::move(done));
+    }
+    BookingAdmission& bookingAdmission() { return admission; }
+    bool cancelBooking(Pnr pnr, const std::string& username);
+    // Train-level operations. Each finds the tickets involved through the
+    // per-train index and is journaled as one record; false if no such train.
+    // Cancels every ticket on the runs from first to last (today at the earliest):
+    bool cancelTrainRuns(int trainNumber, RunDate first, RunDate last, TrainChangeResult& result);
+    // Changes capacity; tickets on removed seats are reseated, or cancelled if the run is full:
+    bool resizeTrain(int trainNumber, int seats, TrainChangeResult& result);
+    bool addTrain(const Train& train);
+    // Seats free over a leg (whole route by default); -1 if there is no such train or leg
+    int seatsLeft(int trainNumber, RunDate date, const std::string& from = "", const std::string& to = "");
+    bool bookable(RunDate date) const; // Today up to kAdvanceBookingDays ahead
+    static constexpr int kAdvanceBookingDays = 120;
+    bool addUser(const std::string& username, const std::string& password);
+    // Bulk loads from CSV. The stream is read in blocks and parsed in
+    // parallel, and bad rows are rejected and reported without stopping the load.
+    ImportResult importTrains(std::istream& in);
+    ImportResult importUsers(std::istream& in);
+    User* authenticate(const std::string& username, const std::string& password); // Runs the KDF
+    // Logs in once and returns a token ("" on bad credentials); resuming costs one lookup
+    std::string openSession(const std::string& username, const std::string& password);
+    std::optional<std::string> resumeSession(const std::string& token); // The user, if live
+    void closeSession(const std::string& token);
+    void setPasswordCost(std::uint32_t iterations) { passwordCost = std::max<std::uint32_t>(1, iterations); }
+    void setSurgePricing(bool enabled) { surgePricing.store(enabled); }
+    RequestScheduler& requestScheduler() { return scheduler; }
+    // Prometheus text exposition: latency histograms and quantiles, counters,
+    // per-train occupancy gauges and alert states since the previous call
+    void renderMetrics(OutputBuffer& out);
+
+    // Read-only listings for headless front ends; limit 0 means no limit
+    void listTrains(TrainSortKey key, std::size_t limit, const std::function<void(const Train&)>& fn);
+    void listTrains(TrainSortKey key, std::size_t limit, const TrainFilter& filter,
+                    const std::function<void(const Train&)>& fn);
+    void listUserTickets(const std::string& username,
+                         const std::function<void(const Ticket&, const Train&)>& fn);
+    // Reports, in train number order over trains with tickets. The dashboard
+    // reads the running totals, O(1) per train; a report scans the ticket
+    // stripes in parallel for an ad-hoc query (one train's through its index).
+    std::vector<ReportRow> dashboard(TicketAggregates::Values& overall);
+    std::vector<ReportRow> runReport(const ReportQuery& query, TicketAggregates::Values& overall);
+    // Streams one CSV row per passenger; returns the rows written
+    std::size_t exportTickets(const ReportQuery& query, std::ostream& out);
+
+    // Routes between two stations, direct trains first; empty if either station is unknown
+    std::vector<std::vector<JourneyLeg>> findJourneys(const std::string& from, const std::string& to,
+                                                      int maxTransfers, std::size_t limit);
+};
+
+// --- Constructor & Initializer ---
+RailwayManager::RailwayManager(std::string dataDirectory, unsigned workers)
+    : pnrAllocator(std::random_device{}()), dataDir(std::move(dataDirectory)),
+      admission(scheduler, [this](std::vector<BookingRequest>& requests, std::vector<BookingResult>& results) {
+          placeBookings(requests, results);
+      }),
+      scheduler(workers) {
+    if (dataDir.empty()) {
+        seedData();
+        return;
+    }
+    if (!recover()) {
+        return; // Leave unreadable files alone rather than overwrite them
+    }
+    evictPastRuns(); // Replay recreates runs for every ticket, including past ones
+    // Fold the replayed tail into a fresh snapshot and start a new journal
+    journal = std::make_unique<WriteAheadLog>();
+    if (!checkpoint()) {
+        journal.reset();
+        std::cerr << "❌ Cannot write to " << dataDir << "; running without persistence." << std::endl;
+    }
+    // Seats may have been freed just before a crash, with no promotion journaled yet
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    for (TrainHandle handle = 0; handle < trains.size(); ++handle) {
+        for (RunDate date : trains[handle].queuePromotions()) requestPromotion(handle, date);
+    }
+}
+
+RailwayManager::~RailwayManager() {
+    scheduler.wait();
+    if (journal) {
+        checkpoint(); // So the next start has no journal to replay
+    }
+    delete catalogView.load();
+}
+
+void RailwayManager::seedData() {
+    NameId admin = NamePool::instance().intern("admin");
+    NameId user = NamePool::instance().intern("user");
+    users.emplace(admin, User(admin, PasswordHasher::hash("admin123", passwordCost), true));
+    users.emplace(user, User(user, PasswordHasher::hash("user123", passwordCost), false));
+
+    // A published binary timetable replaces the built-in sample trains
+    if (!dataDir.empty() && loadTimetable()) {
+        return;
+    }
+    // Trains go through addTrain so the hashed index stays in sync
+    addTrain(Train(12049, "Shatabdi Express", "New Delhi", "Kanpur", toPaise(1500.00), 100,
+                   {"Ghaziabad", "Aligarh", "Tundla", "Etawah"}));
+    addTrain(Train(12951, "Rajdhani Express", "Mumbai", "New Delhi", toPaise(2870.00), 72,
+                   {"Surat", "Vadodara", "Ratlam", "Kota"}));
+    addTrain(Train(22439, "Vande Bharat", "New Delhi", "Katra", toPaise(1800.50), 80,
+                   {"Ambala", "Ludhiana", "Jammu Tawi"}));
+    addTrain(Train(12301, "Howrah Rajdhani", "Kolkata", "New Delhi", toPaise(2950.00), 72,
+                   {"Dhanbad", "Gaya", "Prayagraj", "Kanpur"}));
+    addTrain(Train(15027, "Maurya Express", "Gorakhpur", "Hatia", toPaise(750.00), 200,
+                   {"Varanasi", "Gaya", "Dhanbad", "Ranchi"}));
+}
+
+/*
+ * Builds the catalog from the memory-mapped timetable. Fixed-layout records
+ * need no parsing, and the indexes are built once at the end rather than
+ * per train. Trains added later form an overlay that the next checkpoint
+ * compacts back into the file.
+ */
+bool RailwayManager::loadTimetable() {
+    TimetableImage image;
+    if (!image.open(timetablePath())) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(catalogMutex);
+    trainIndex.reserve(trains.size() + image.size());
+    columns.reserve(trains.size() + image.size());
+    for (std::size_t i = 0; i < image.size(); ++i) {
+        const TimetableImage::Record& r = image.record(i);
+        if (!trainIndex.insert(r.trainNumber, static_cast<TrainHandle>(trains.size()))) continue;
+        appendFromImage(image, r, r.fare, r.totalSeats);
+    }
+    bookedTickets.trackTrains(trains.size());
+    sortViews.rebuild();
+    ++catalogVersion;
+    timetableTrains = trains.size();
+    return true;
+}
+
+void RailwayManager::appendFromImage(const TimetableImage& image, const TimetableImage::Record& r, Paise fare,
+                                     int seats) {
+    std::vector<std::string> stops;
+    std::istringstream joined(image.text(r.stops));
+    for (std::string stop; std::getline(joined, stop, TimetableImage::kStopSeparator);) {
+        stops.push_back(stop);
+    }
+    trains.emplace_back(r.trainNumber, image.text(r.name), image.text(r.source), image.text(r.destination), fare,
+                        seats, std::move(stops));
+    routeIndex.addTrain(static_cast<TrainHandle>(trains.size() - 1), trains.back());
+    columns.append(trains.back());
+}
+
+// Appends a train and indexes it by number. Fails on a duplicate number.
+bool RailwayManager::addTrain(const Train& train) {
+    std::uint64_t lsn;
+    {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        TrainHandle handle = static_cast<TrainHandle>(trains.size());
+        if (!trainIndex.insert(train.trainNumber, handle)) {
+            return false;
+        }
+        trains.push_back(train);
+        columns.append(trains.back());
+        bookedTickets.trackTrains(trains.size());
+        sortViews.insert(handle);
+        routeIndex.addTrain(handle, trains.back());
+        ++catalogVersion;
+
+        BinaryWriter record;
+        record.put(JournalEvent::AddTrain);
+        writeTrain(record, train);
+        lsn = logEvent(record);
+    }
+    awaitDurable(lsn);
+    return true;
+}
+
+void RailwayManager::setFare(TrainHandle handle, Paise fare) {
+    trains[handle].setFare(fare);
+    columns.fares[handle] = fare;
+    sortViews.fareChanged(handle);
+    ++catalogVersion;
+}
+
+void RailwayManager::setCapacity(TrainHandle handle, int seats) {
+    trains[handle].setCapacity(seats);
+    columns.capacities[handle] = seats;
+    ++catalogVersion;
+}
+
+/*
+ * Listings find the published snapshot current and take no lock at all.
+ * The first one after a catalog change copies the columns and views under
+ * the shared catalog lock, publishes the copy and retires the old one.
+ * Copying is linear in trains, but only listings pay for it, once per
+ * change, so a bulk load of trains costs no more than before.
+ */
+const CatalogSnapshot& RailwayManager::catalogSnapshot() {
+    const CatalogSnapshot* view = catalogView.load(std::memory_order_acquire);
+    if (view && view->version == catalogVersion.load()) return *view;
+
+    std::lock_guard<std::mutex> publishing(catalogViewMutex);
+    view = catalogView.load(std::memory_order_acquire);
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    std::uint64_t version = catalogVersion.load(); // Writers bump it under the exclusive lock
+    if (view && view->version == version) return *view;
+    auto fresh = std::make_unique<CatalogSnapshot>();
+    fresh->version = version;
+    fresh->trains.reserve(trains.size());
+    for (const Train& train : trains) fresh->trains.push_back(&train);
+    fresh->columns = columns;
+    for (int k = 0; k < 3; ++k) fresh->views[k] = sortViews.view(static_cast<TrainSortKey>(k));
+    catalogView.store(fresh.get(), std::memory_order_release);
+    if (view) retiredViews.retire(readEpochs, std::unique_ptr<const CatalogSnapshot>(view));
+    retiredViews.reclaim(readEpochs);
+    return *fresh.release();
+}
+
+// O(1) average lookup through the hashed index; nullptr if not found
+Train* RailwayManager::findTrain(int trainNumber) {
+    TrainHandle handle = trainIndex.find(trainNumber);
+    return handle == TrainIndex::npos ? nullptr : &trains[handle];
+}
+
+int RailwayManager::seatsLeft(int trainNumber, RunDate date, const std::string& from, const std::string& to) {
+    LatencyTimer timer(metrics[RailwayMetrics::SeatLookup]);
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    Train* train = findTrain(trainNumber);
+    if (!train) return -1;
+    int boarding = from.empty() ? 0 : train->stationIndex(from);
+    int alighting = to.empty() ? train->segments() : train->stationIndex(to);
+    return boarding >= 0 && alighting > boarding ? train->seatsFree(date, boarding, alighting) : -1;
+}
+
+bool RailwayManager::bookable(RunDate date) const {
+    RunDate today = currentDate();
+    return date >= today && date <= today + kAdvanceBookingDays;
+}
+
+// Drops seat inventories of dates that have passed; runs at most once a day
+void RailwayManager::evictPastRuns() {
+    RunDate today = currentDate();
+    RunDate swept = sweptBefore.load(std::memory_order_relaxed);
+    if (swept >= today || !sweptBefore.compare_exchange_strong(swept, today)) {
+        return;
+    }
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    for (Train& train : trains) {
+        train.evictRunsBefore(today);
+    }
+}
+
+Pnr RailwayManager::generatePNR(std::size_t shard) {
+    LatencyTimer timer(metrics[RailwayMetrics::GeneratePnr]);
+    return pnrAllocator.next(shard);
+}
+
+// --- Booking Core ---
+
+BookingResult RailwayManager::placeBooking(int trainNumber, RunDate date, PassengerList passengers,
+                                           const std::string& username, const std::string& from,
+                                           const std::string& to, bool joinWaitlist, Quota quota) {
+    std::vector<BookingRequest> batch(1);
+    batch[0] = BookingRequest{trainNumber, date, std::move(passengers), username, from, to, joinWaitlist, quota};
+    std::vector<BookingResult> results;
+    placeBookings(batch, results);
+    return results[0];
+}
+
+/*
+ * Linearizability: a booking takes effect when Train::allocate marks its
+ * seats sold under the train's seat lock, and a cancellation at the removal
+ * of its ticket from the store. Seats are taken before a ticket is published and returned only after
+ * it is removed, so at every instant the seats held on a train cover all of
+ * its live tickets. Bookings hold catalogMutex shared, so they never block
+ * one another; only adding or modifying a train takes it exclusively.
+ *
+ * Durability: a booking is journaled before its ticket is published, so any
+ * cancellation of it is journaled later. The call returns once the journal
+ * batch holding every booking in it has been fsynced.
+ *
+ * Waiting: a booking without seats is journaled and published as a waiting
+ * ticket before it joins the train's queue, so a promotion that cannot find
+ * its ticket knows the ticket was cancelled.
+ *
+ * Batching: the catalog lock is taken once per batch and each train's seat
+ * lock once per train in it, so a burst on one train costs one allocation
+ * pass and one fsync wait rather than one of each per booking. A train's
+ * bookings are served in the order given.
+ */
+void RailwayManager::placeBookings(std::vector<BookingRequest>& requests, std::vector<BookingResult>& results) {
+    // Every booking in the batch waits for all of it, so each is that long
+    LatencyTimer timer(metrics[RailwayMetrics::Book], requests.size());
+    results.assign(requests.size(), BookingResult());
+    evictPastRuns();
+
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    // Few trains share a batch, so a linear search finds each one's group
+    std::vector<std::pair<TrainHandle, std::vector<Train::SeatRequest>>> groups;
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        const BookingRequest& request = requests[i];
+        if (request.passengers.empty() || !bookable(request.date)) {
+            continue; // InvalidRequest
+        }
+        TrainHandle handle = trainIndex.find(request.trainNumber);
+        if (handle == TrainIndex::npos) {
+            results[i].status = BookingStatus::NoSuchTrain;
+            continue;
+        }
+        const Train& train = trains[handle];
+        if (train.runCancelled(request.date)) {
+            results[i].status = BookingStatus::RunCancelled;
+            continue;
+        }
+        int boarding = request.from.empty() ? 0 : train.stationIndex(request.from);
+        int alighting = request.to.empty() ? train.segments() : train.stationIndex(request.to);
+        if (boarding < 0 || alighting <= boarding) {
+            continue; // InvalidRequest: not a forward leg of this route
+        }
+        auto group = std::find_if(groups.begin(), groups.end(),
+                                  [handle](const auto& entry) { return entry.first == handle; });
+        if (group == groups.end()) group = groups.emplace(groups.end(), handle, std::vector<Train::SeatRequest>());
+        group->second.push_back(Train::SeatRequest{request.date, static_cast<int>(request.passengers.size()),
+                                                   boarding, alighting, request.joinWaitlist, i, {}});
+    }
+
+    std::uint64_t lsn = 0;
+    for (auto& group : groups) {
+        TrainHandle handle = group.first;
+        Train& train = trains[handle];
+        train.allocate(group.second);
+        for (Train::SeatRequest& allocated : group.second) {
+            BookingRequest& request = requests[allocated.slot];
+            BookingResult& result = results[allocated.slot];
+            result.seatsLeft = allocated.seatsLeft;
+            if (allocated.seats.empty() && !allocated.waitSeq) {
+                result.status = BookingStatus::NotEnoughSeats;
+                continue;
+            }
+
+            // Allocated PNRs are unique, so this only loops if the shard's counter has
+            // wrapped. The PNR names the shard the train's tickets live in. If every
+            // attempt is in use the seats go back; an unused waiting place is a gap.
+            std::size_t shard = TicketStore::shardOfTrain(handle);
+            Pnr pnr = generatePNR(shard);
+            int attempts = 1;
+            while (bookedTickets.contains(pnr) && attempts < PnrAllocator::kMaxAttempts) {
+                metrics.pnrRetries.add();
+                pnr = generatePNR(shard);
+                ++attempts;
+            }
+            if (attempts == PnrAllocator::kMaxAttempts && bookedTickets.contains(pnr)) {
+                result.status = BookingStatus::PnrsExhausted;
+                if (!allocated.waitSeq &&
+                    train.cancelSeats(allocated.date, allocated.seats, allocated.from, allocated.to)) {
+                    requestPromotion(handle, allocated.date);
+                }
+                continue;
+            }
+
+            // Priced on the seats the leg had before this booking: with surge
+            // pricing, a booking that fills the leg pays the rate it found
+            int tenths = 0;
+            if (surgePricing.load(std::memory_order_relaxed)) {
+                int seatsBefore = allocated.seatsLeft + static_cast<int>(allocated.seats.size());
+                tenths = FareEngine::soldTenths(train.totalSeats.load(), seatsBefore);
+            }
+            FareEngine::price(train.fareTable, request.quota, allocated.to - allocated.from, tenths,
+                              request.passengers);
+
+            // Passengers are moved in, so the only allocation left is the store's node
+            Ticket ticket(pnr, handle, train.trainNumber, NamePool::instance().intern(request.username),
+                          std::move(request.passengers));
+            ticket.quota = request.quota;
+            Paise fare = ticket.totalFare();
+            ticket.travelDate = allocated.date;
+            ticket.fromStation = allocated.from;
+            ticket.toStation = allocated.to;
+            ticket.seats = std::move(allocated.seats);
+            ticket.status = allocated.waitSeq ? TicketStatus::Waiting : TicketStatus::Confirmed;
+            ticket.waitSeq = allocated.waitSeq;
+            BinaryWriter record;
+            record.put(JournalEvent::Book);
+            writeTicket(record, ticket);
+            lsn = std::max(lsn, logEvent(record));
+            bookedTickets.insert(std::move(ticket));
+
+            result.status = BookingStatus::Booked;
+            result.pnr = pnr;
+            result.fare = fare;
+            if (allocated.waitSeq) {
+                result.status = BookingStatus::Waitlisted;
+                WaitQueue::Entry entry{pnr, allocated.count, allocated.from, allocated.to};
+                bool promote = train.joinWaitlist(allocated.date, allocated.waitSeq, entry);
+                // The place is read before the pass can confirm the booking and take it
+                train.waitStatus(allocated.date, allocated.waitSeq, result.waitClass, result.waitPlace);
+                if (promote) requestPromotion(handle, allocated.date);
+            }
+        }
+    }
+    lock.unlock();
+
+    awaitDurable(lsn);
+    maybeCheckpoint();
+    for (const BookingResult& result : results) {
+        if (result.status == BookingStatus::Booked) metrics.booked.add();
+        else if (result.status == BookingStatus::Waitlisted) metrics.waitlisted.add();
+        else metrics.bookingsRefused.add();
+    }
+}
+
+bool RailwayManager::cancelBooking(Pnr pnr, const std::string& username) {
+    LatencyTimer timer(metrics[RailwayMetrics::Cancel]);
+    std::uint64_t lsn;
+    {
+        // Catalog first, so a checkpoint never sees the ticket gone but its seats unreturned
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        std::optional<Ticket> booked = bookedTickets.find(pnr);
+        if (!booked || booked->travelDate < currentDate()) {
+            metrics.cancelsRefused.add();
+            return false; // Tickets for past dates stay as history
+        }
+        std::optional<Ticket> ticket = bookedTickets.extract(pnr, NamePool::instance().find(username));
+        if (!ticket) {
+            metrics.cancelsRefused.add();
+            return false;
+        }
+        // Journaled before the seats go back, so whatever is sold them next is journaled after
+        BinaryWriter record;
+        record.put(JournalEvent::Cancel);
+        record.put(pnr);
+        record.putString(username);
+        lsn = logEvent(record);
+
+        Train& train = trains[ticket->train];
+        if (ticket->status == TicketStatus::Waiting) {
+            // Already gone if a promotion has just sold it seats; that promotion hands them back
+            train.leaveWaitlist(ticket->travelDate, ticket->waitSeq);
+        } else if (train.cancelSeats(ticket->travelDate, ticket->seats, ticket->fromStation,
+                                     ticket->toStation)) {
+            requestPromotion(ticket->train, ticket->travelDate);
+        }
+    }
+    awaitDurable(lsn);
+    maybeCheckpoint();
+    metrics.cancelled.add();
+    return true;
+}
+
+/*
+ * Train-level operations hold the catalog exclusively, so no booking can
+ * land on the train while its tickets are collected and changed, and each
+ * writes one journal record listing the tickets it removed or moved: a
+ * single fsync however many there are, and all or none of it on replay.
+ * Tickets of past runs are left alone as history. Cancelled dates stay
+ * closed to bookings until they have passed.
+ */
+bool RailwayManager::cancelTrainRuns(int trainNumber, RunDate first, RunDate last, TrainChangeResult& result) {
+    result = TrainChangeResult();
+    std::uint64_t lsn;
+    {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        TrainHandle handle = trainIndex.find(trainNumber);
+        if (handle == TrainIndex::npos) return false;
+        first = std::max(first, currentDate());
+        std::vector<Pnr> affected;
+        bookedTickets.forEachOnTrain(handle, [&](const Ticket& ticket) {
+            if (ticket.travelDate >= first && ticket.travelDate <= last) affected.push_back(ticket.pnr);
+        });
+        BinaryWriter record;
+        record.put(JournalEvent::CancelRuns);
+        record.put(handle);
+        record.put(first);
+        record.put(last);
+        record.put(static_cast<std::uint32_t>(affected.size()));
+        for (Pnr pnr : affected) record.put(pnr);
+        lsn = logEvent(record);
+
+        for (const Ticket& ticket : bookedTickets.extractAll(affected)) {
+            ++result.cancelled;
+            result.passengers += ticket.passengers.size();
+        }
+        trains[handle].cancelRuns(first, last); // Waiting lists go with the seats
+    }
+    awaitDurable(lsn);
+    maybeCheckpoint();
+    return true;
+}
+
+// Displaced tickets are reseated in the order the train's index lists them
+// (booking order, since the last restart); on a run now over capacity, the
+// ones left when its free seats run out are cancelled
+bool RailwayManager::resizeTrain(int trainNumber, int seats, TrainChangeResult& result) {
+    result = TrainChangeResult();
+    seats = std::max(0, seats);
+    std::uint64_t lsn;
+    {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        TrainHandle handle = trainIndex.find(trainNumber);
+        if (handle == TrainIndex::npos) return false;
+        Train& train = trains[handle];
+        std::vector<Pnr> displaced;
+        std::vector<Train::Reseat> moves;
+        if (seats < train.totalSeats.load()) {
+            RunDate today = currentDate();
+            bookedTickets.forEachOnTrain(handle, [&](const Ticket& ticket) {
+                if (ticket.status != TicketStatus::Confirmed || ticket.travelDate < today) return;
+                if (std::none_of(ticket.seats.begin(), ticket.seats.end(), [seats](int seat) { return seat >= seats; })) {
+                    return;
+                }
+                displaced.push_back(ticket.pnr);
+                moves.push_back(Train::Reseat{ticket.travelDate, ticket.fromStation, ticket.toStation, ticket.seats});
+            });
+        }
+        setCapacity(handle, seats);
+        train.reseat(moves);
+
+        std::vector<Pnr> cancelled;
+        BinaryWriter record;
+        record.put(JournalEvent::SetSeats);
+        record.put(handle);
+        record.put<std::int32_t>(seats);
+        std::uint32_t kept = static_cast<std::uint32_t>(
+            std::count_if(moves.begin(), moves.end(), [](const Train::Reseat& move) { return move.kept; }));
+        record.put(kept);
+        for (std::size_t i = 0; i < moves.size(); ++i) {
+            if (!moves[i].kept) {
+                cancelled.push_back(displaced[i]);
+                continue;
+            }
+            record.put(displaced[i]);
+            record.put(static_cast<std::uint32_t>(moves[i].seats.size()));
+            for (int seat : moves[i].seats) record.put<std::int32_t>(seat);
+            bookedTickets.modify(displaced[i], [&moves, i](Ticket& ticket) { ticket.seats = moves[i].seats; });
+            ++result.reseated;
+        }
+        record.put(static_cast<std::uint32_t>(cancelled.size()));
+        for (Pnr pnr : cancelled) record.put(pnr);
+        lsn = logEvent(record);
+
+        for (const Ticket& ticket : bookedTickets.extractAll(cancelled)) {
+            ++result.cancelled;
+            result.passengers += ticket.passengers.size();
+        }
+        // Added seats go to bookings waiting for them
+        for (RunDate date : train.queuePromotions()) requestPromotion(handle, date);
+    }
+    awaitDurable(lsn);
+    maybeCheckpoint();
+    return true;
+}
+
+// Passes for one train run one after another on its shard, queued behind the
+// bookings already sent there, and a cancellation never waits for one
+void RailwayManager::requestPromotion(TrainHandle handle, RunDate date) {
+    scheduler.submitTo(BookingAdmission::lane(trains[handle].trainNumber),
+                       [this, handle, date] { promoteWaiting(handle, date); });
+}
+
+/*
+ * One batched pass over a run's waiting list: every entry that now fits is
+ * sold seats under one hold of the seat lock, then confirmed in the ticket
+ * store and journaled. Cancellations that arrive meanwhile coalesce into the
+ * next pass. The pass doesn't wait for the fsync; if it is lost in a crash,
+ * recovery finds the tickets still waiting and promotes them again.
+ */
+void RailwayManager::promoteWaiting(TrainHandle handle, RunDate date) {
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    Train& train = trains[handle];
+    std::vector<WaitQueue::Promotion> promoted;
+    train.promoteWaiting(date, promoted);
+    for (const WaitQueue::Promotion& promotion : promoted) {
+        bool confirmed = bookedTickets.modify(promotion.pnr, [this, &promotion](Ticket& ticket) {
+            ticket.status = TicketStatus::Confirmed;
+            ticket.seats = promotion.seats;
+            BinaryWriter record;
+            record.put(JournalEvent::Promote);
+            record.put(promotion.pnr);
+            record.put(static_cast<std::uint32_t>(promotion.seats.size()));
+            for (int seat : promotion.seats) record.put<std::int32_t>(seat);
+            logEvent(record);
+        });
+        // Cancelled while its seats were being sold: they go to the next in line
+        if (!confirmed && train.cancelSeats(date, promotion.seats, promotion.from, promotion.to)) {
+            requestPromotion(handle, date);
+        }
+    }
+    lock.unlock();
+    if (!promoted.empty()) maybeCheckpoint();
+}
+
+// The KDF runs outside usersMutex so a registration doesn't stall every login
+bool RailwayManager::addUser(const std::string& username, const std::string& password) {
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        if (users.count(NamePool::instance().find(username))) return false;
+    }
+    std::string credential = PasswordHasher::hash(password, passwordCost);
+    NameId name = NamePool::instance().intern(username);
+    std::uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        if (!users.emplace(name, User(name, credential)).second) {
+            return false;
+        }
+        BinaryWriter record;
+        record.put(JournalEvent::RegisterUser);
+        record.putString(username);
+        record.putString(credential);
+        record.put(false);
+        lsn = logEvent(record);
+    }
+    awaitDurable(lsn);
+    return true;
+}
+
+// Users are never removed and credentials never change, so the pointer and
+// the credential stay valid after the lock is released for the KDF
+User* RailwayManager::authenticate(const std::string& username, const std::string& password) {
+    LatencyTimer timer(metrics[RailwayMetrics::Login]);
+    User* user = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        auto userIt = users.find(NamePool::instance().find(username));
+        if (userIt != users.end()) user = &userIt->second;
+    }
+    if (!user || !PasswordHasher::verify(password, user->credential)) {
+        metrics.loginsFailed.add();
+        return nullptr;
+    }
+    return user;
+}
+
+std::string RailwayManager::openSession(const std::string& username, const std::string& password) {
+    return authenticate(username, password) ? sessions.issue(username) : std::string();
+}
+
+std::optional<std::string> RailwayManager::resumeSession(const std::string& token) {
+    LatencyTimer timer(metrics[RailwayMetrics::SessionResume]);
+    return sessions.validate(token);
+}
+
+void RailwayManager::closeSession(const std::string& token) {
+    sessions.revoke(token);
+}
+
+void RailwayManager::listTrains(TrainSortKey key, std::size_t limit,
+                                const std::function<void(const Train&)>& fn) {
+    LatencyTimer timer(metrics[RailwayMetrics::TrainListing]);
+    EpochDomain::Guard pinned(readEpochs);
+    const CatalogSnapshot& catalog = catalogSnapshot();
+    const std::vector<TrainHandle>& order = catalog.view(key);
+    std::size_t end = limit > 0 ? std::min(limit, order.size()) : order.size();
+    for (std::size_t i = 0; i < end; ++i) {
+        fn(catalog.train(order[i]));
+    }
+}
+
+/*
+ * Fare and capacity are tested in one vectorized pass over the columns,
+ * leaving a byte mask the sorted walk consults per train. Only trains that
+ * pass it have their seat inventory for the date checked.
+ */
+std::vector<TrainHandle> RailwayManager::filteredView(const CatalogSnapshot& catalog, TrainSortKey key,
+                                                      const TrainFilter& filter, std::size_t limit) {
+    std::vector<std::uint8_t> mask;
+    catalog.columns.match(filter.minFare, filter.maxFare, filter.minSeats, mask);
+    std::vector<TrainHandle> matches;
+    for (TrainHandle handle : catalog.view(key)) {
+        if (!mask[handle]) continue;
+        const Train& train = catalog.train(handle);
+        if (filter.minSeats > 0 && train.seatsFree(filter.date, 0, train.segments()) < filter.minSeats) continue;
+        matches.push_back(handle);
+        if (matches.size() == limit) break;
+    }
+    return matches;
+}
+
+void RailwayManager::listTrains(TrainSortKey key, std::size_t limit, const TrainFilter& filter,
+                                const std::function<void(const Train&)>& fn) {
+    LatencyTimer timer(metrics[RailwayMetrics::TrainListing]);
+    EpochDomain::Guard pinned(readEpochs);
+    const CatalogSnapshot& catalog = catalogSnapshot();
+    for (TrainHandle handle : filteredView(catalog, key, filter, limit)) {
+        fn(catalog.train(handle));
+    }
+}
+
+void RailwayManager::listUserTickets(const std::string& username,
+                                     const std::function<void(const Ticket&, const Train&)>& fn) {
+    LatencyTimer timer(metrics[RailwayMetrics::TicketLookup]);
+    EpochDomain::Guard pinned(readEpochs);
+    // Tickets first: any train they name was added before they were booked,
+    // so a catalog snapshot taken afterwards includes it
+    TicketStore::Snapshot tickets = bookedTickets.snapshotOfUser(NamePool::instance().find(username));
+    const CatalogSnapshot& catalog = catalogSnapshot();
+    for (const Ticket* ticket : tickets) fn(*ticket, catalog.train(ticket->train));
+}
+
+std::vector<std::vector<JourneyLeg>> RailwayManager::findJourneys(const std::string& from, const std::string& to,
+                                                                 int maxTransfers, std::size_t limit) {
+    LatencyTimer timer(metrics[RailwayMetrics::JourneySearch]);
+    std::vector<std::vector<JourneyLeg>> journeys;
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    StationId src = routeIndex.findStation(from);
+    StationId dst = routeIndex.findStation(to);
+    if (src == RouteIndex::npos || dst == RouteIndex::npos) return journeys;
+    for (const RouteIndex::Journey& plan : routeIndex.plan(src, dst, maxTransfers, limit)) {
+        std::vector<JourneyLeg> legs;
+        for (const RouteIndex::Leg& leg : plan) {
+            const Train& train = trains[leg.train];
+            const std::string& boarding = routeIndex.stationName(leg.from);
+            const std::string& alighting = routeIndex.stationName(leg.to);
+            int distance = std::max(1, train.stationIndex(alighting) - train.stationIndex(boarding));
+            legs.push_back(JourneyLeg{train.trainNumber, train.trainName(), boarding, alighting,
+                                      train.fareTable.at(Quota::General, distance).fare});
+        }
+        journeys.push_back(std::move(legs));
+    }
+    return journeys;
+}
+
+// --- Metrics Export ---
+
+/*
+ * Histograms and counters are summed from their stripes, and the occupancy
+ * gauges are read from each train under its own seat lock, so a scrape never
+ * blocks bookings on more than one train at a time. Alerts compare with the
+ * previous scrape: booking p99 over the interval against kBookingP99Alert,
+ * and any PNR retry at all. A newly firing alert is also logged.
+ */
+void RailwayManager::renderMetrics(OutputBuffer& out) {
+    auto seconds = [&out](std::uint64_t nanos) -> OutputBuffer& { return out.number(nanos / 1e9); };
+
+    out << "# HELP railway_op_latency_seconds Latency of booking-core operations.";
+    out.line();
+    out << "# TYPE railway_op_latency_seconds histogram";
+    out.line();
+    LatencyHistogram::Snapshot bookings;
+    for (std::size_t op = 0; op < RailwayMetrics::kOperations; ++op) {
+        LatencyHistogram::Snapshot snapshot = metrics.latency[op].snapshot();
+        const char* name = RailwayMetrics::kNames[op];
+        for (double bound : kExportedLatencyBounds) {
+            out << "railway_op_latency_seconds_bucket{op=\"" << name << "\",le=\"";
+            out.number(bound) << "\"} " << snapshot.atOrBelow(static_cast<std::uint64_t>(bound * 1e9));
+            out.line();
+        }
+        out << "railway_op_latency_seconds_bucket{op=\"" << name << "\",le=\"+Inf\"} " << snapshot.total;
+        out.line();
+        out << "railway_op_latency_seconds_sum{op=\"" << name << "\"} ";
+        seconds(snapshot.sum).line();
+        out << "railway_op_latency_seconds_count{op=\"" << name << "\"} " << snapshot.total;
+        out.line();
+        if (op == RailwayMetrics::Book) bookings = std::move(snapshot);
+    }
+    out << "# HELP railway_op_latency_quantile_seconds Latency quantiles since start, within 3%.";
+    out.line();
+    out << "# TYPE railway_op_latency_quantile_seconds gauge";
+    out.line();
+    for (std::size_t op = 0; op < RailwayMetrics::kOperations; ++op) {
+        LatencyHistogram::Snapshot snapshot = op == RailwayMetrics::Book ? bookings : metrics.latency[op].snapshot();
+        for (double q : {0.5, 0.99, 0.999}) {
+            out << "railway_op_latency_quantile_seconds{op=\"" << RailwayMetrics::kNames[op] << "\",quantile=\"";
+            out.number(q) << "\"} ";
+            seconds(snapshot.quantile(q)).line();
+        }
+    }
+
+    auto counter = [&out](const char* name, const char* help, std::uint64_t value) {
+        out << "# HELP " << name << ' ' << help;
+        out.line();
+        out << "# TYPE " << name << " counter";
+        out.line();
+        out << name << ' ' << value;
+        out.line();
+    };
+    out << "# HELP railway_bookings_total Bookings placed, by outcome.";
+    out.line();
+    out << "# TYPE railway_bookings_total counter";
+    out.line();
+    out << "railway_bookings_total{outcome=\"confirmed\"} " << metrics.booked.value();
+    out.line();
+    out << "railway_bookings_total{outcome=\"waitlisted\"} " << metrics.waitlisted.value();
+    out.line();
+    out << "railway_bookings_total{outcome=\"refused\"} " << metrics.bookingsRefused.value();
+    out.line();
+    out << "# HELP railway_cancellations_total Cancellations, by outcome.";
+    out.line();
+    out << "# TYPE railway_cancellations_total counter";
+    out.line();
+    out << "railway_cancellations_total{outcome=\"cancelled\"} " << metrics.cancelled.value();
+    out.line();
+    out << "railway_cancellations_total{outcome=\"refused\"} " << metrics.cancelsRefused.value();
+    out.line();
+    std::uint64_t pnrRetries = metrics.pnrRetries.value();
+    counter("railway_logins_failed_total", "Logins refused for bad credentials.", metrics.loginsFailed.value());
+    counter("railway_pnr_retries_total", "Allocated PNRs found already in use.", pnrRetries);
+    BookingAdmission::Stats admitted = admission.stats();
+    counter("railway_admission_admitted_total", "Bookings admitted to a micro-batch.", admitted.admitted);
+    counter("railway_admission_batches_total", "Micro-batches applied.", admitted.batches);
+    counter("railway_admission_rate_limited_total", "Bookings refused by a token bucket.", admitted.rateLimited);
+    counter("railway_admission_shed_total", "Bookings shed by a full or slow lane.", admitted.shed);
+    RequestScheduler::Stats pool = scheduler.stats();
+    counter("railway_scheduler_executed_total", "Tasks run by the scheduler.", pool.executed);
+    counter("railway_scheduler_stolen_total", "Tasks run by a worker other than the one queued on.", pool.stolen);
+    out << "# HELP railway_scheduler_queue_depth Tasks waiting, per worker.";
+    out.line();
+    out << "# TYPE railway_scheduler_queue_depth gauge";
+    out.line();
+    for (std::size_t i = 0; i < pool.depth.size(); ++i) {
+        out << "railway_scheduler_queue_depth{worker=\"" << i << "\"} " << pool.depth[i];
+        out.line();
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        std::vector<Train::Occupancy> occupancy;
+        occupancy.reserve(trains.size());
+        for (const Train& train : trains) occupancy.push_back(train.occupancy());
+        auto gauge = [&](const char* name, const char* help, auto value) {
+            out << "# HELP " << name << ' ' << help;
+            out.line();
+            out << "# TYPE " << name << " gauge";
+            out.line();
+            for (std::size_t handle = 0; handle < trains.size(); ++handle) {
+                out << name << "{train=\"" << trains[handle].trainNumber << "\"} " << value(occupancy[handle]);
+                out.line();
+            }
+        };
+        gauge("railway_train_seats_held", "Seats sold on some segment, summed over open runs.",
+              [](const Train::Occupancy& o) { return o.seatsHeld; });
+        gauge("railway_train_seat_capacity", "Seats across open runs.",
+              [](const Train::Occupancy& o) { return o.seatCapacity; });
+        gauge("railway_train_waiting_passengers", "Passengers on RAC or the waiting list.",
+              [](const Train::Occupancy& o) { return o.waitingPassengers; });
+    }
+
+    std::lock_guard<std::mutex> lock(scrapeMutex);
+    std::uint64_t intervalP99 = bookings.since(lastBookings).quantile(0.99);
+    bool slowBookings = intervalP99 > RailwayMetrics::kBookingP99Alert;
+    bool retriedPnrs = pnrRetries > lastPnrRetries;
+    if (slowBookings && !bookingAlert) {
+        std::cerr << "❌ Alert: booking p99 " << intervalP99 / 1000000 << " ms since the last scrape" << std::endl;
+    }
+    if (retriedPnrs && !pnrAlert) {
+        std::cerr << "❌ Alert: " << pnrRetries - lastPnrRetries << " PNR retries; the allocator has wrapped"
+                  << std::endl;
+    }
+    bookingAlert = slowBookings;
+    pnrAlert = retriedPnrs;
+    lastBookings = std::move(bookings);
+    lastPnrRetries = pnrRetries;
+    out << "# HELP railway_alert Alerts judged over the interval since the previous scrape.";
+    out.line();
+    out << "# TYPE railway_alert gauge";
+    out.line();
+    out << "railway_alert{alert=\"BookingLatencyHigh\"} " << (bookingAlert ? 1 : 0);
+    out.line();
+    out << "railway_alert{alert=\"PnrRetries\"} " << (pnrAlert ? 1 : 0);
+    out.line();
+}
+
+// --- Reports ---
+
+std::vector<ReportRow> RailwayManager::dashboard(TicketAggregates::Values& overall) {
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    const TicketAggregates& totals = bookedTickets.totals();
+    std::vector<ReportRow> rows;
+    for (TrainHandle handle : sortViews.view(TrainSortKey::Number)) {
+        TicketAggregates::Values values = totals.ofTrain(handle);
+        if (values[TicketAggregates::Tickets] > 0) {
+            rows.push_back(ReportRow{trains[handle].trainNumber, trains[handle].trainName(), values,
+                                     trains[handle].occupancy()});
+        }
+    }
+    overall = totals.overall();
+    return rows;
+}
+
+/*
+ * Each task takes every workers-th shard, projects it into a TicketColumns
+ * batch under the shard lock and aggregates it into totals of its own, so
+ * tasks share nothing until their totals are added up at the end.
+ */
+std::vector<ReportRow> RailwayManager::runReport(const ReportQuery& query, TicketAggregates::Values& overall) {
+    overall = TicketAggregates::Values{};
+    std::shared_lock<std::shared_mutex> lock(catalogMutex);
+    TrainHandle only = TrainIndex::npos;
+    if (query.trainNumber != 0 && (only = trainIndex.find(query.trainNumber)) == TrainIndex::npos) return {};
+
+    std::vector<TicketAggregates::Values> perTrain(trains.size());
+    if (only != TrainIndex::npos) {
+        TicketColumns batch;
+        bookedTickets.forEachOnTrain(only, [&batch](const Ticket& ticket) { batch.append(ticket); });
+        batch.aggregate(query, only, perTrain);
+    } else {
+        std::size_t tasks = std::min(scheduler.workers(), TicketStore::kShards);
+        std::vector<std::vector<TicketAggregates::Values>> partial(tasks);
+        scheduler.parallelFor(tasks, [&](std::size_t task) {
+            partial[task].resize(trains.size());
+            TicketColumns batch;
+            auto copy = [&batch](const Ticket& ticket) { batch.append(ticket); };
+            for (std::size_t shard = task; shard < TicketStore::kShards; shard += tasks) {
+                batch.clear();
+                bookedTickets.forEachInShard(shard, copy);
+                batch.aggregate(query, only, partial[task]);
+            }
+        });
+        for (const auto& totals : partial) {
+            for (TrainHandle handle = 0; handle < trains.size(); ++handle) TicketAggregates::add(perTrain[handle], totals[handle]);
+        }
+    }
+
+    std::vector<ReportRow> rows;
+    for (TrainHandle handle : sortViews.view(TrainSortKey::Number)) {
+        if (perTrain[handle][TicketAggregates::Tickets] == 0) continue;
+        rows.push_back(ReportRow{trains[handle].trainNumber, trains[handle].trainName(), perTrain[handle]});
+        TicketAggregates::add(overall, perTrain[handle]);
+    }
+    return rows;
+}
+
+// Rendered a wave of shards at a time in parallel, as in the all-tickets
+// report, and written in shard order; memory stays at one wave's text.
+// Works from snapshots, so a slow file holds up no booking.
+std::size_t RailwayManager::exportTickets(const ReportQuery& query, std::ostream& stream) {
+    OutputBuffer out(stream);
+    out << "pnr,train,date,from,to,status,quota,booked_by,passenger,age,gender,seat,fare";
+    out.line();
+    EpochDomain::Guard pinned(readEpochs);
+    std::vector<TicketStore::Snapshot> shards;
+    TrainHandle handle = TrainIndex::npos;
+    if (query.trainNumber != 0) {
+        {
+            std::shared_lock<std::shared_mutex> lock(catalogMutex); // Only for the lookup
+            handle = trainIndex.find(query.trainNumber);
+        }
+        if (handle == TrainIndex::npos) return 0;
+        shards.push_back(bookedTickets.snapshotOnTrain(handle));
+    } else {
+        shards.resize(TicketStore::kShards);
+        for (std::size_t i = 0; i < shards.size(); ++i) bookedTickets.snapshotShard(i, shards[i]);
+    }
+    const CatalogSnapshot& catalog = catalogSnapshot();
+    auto render = [&query, &catalog](OutputBuffer& page, const Ticket& ticket) -> std::size_t {
+        if (!query.covers(ticket)) return 0;
+        const Train& train = catalog.train(ticket.train);
+        for (std::size_t i = 0; i < ticket.passengers.size(); ++i) {
+            const Passenger& passenger = ticket.passengers[i];
+            page << ticket.pnr << ',' << ticket.trainNumber << ',';
+            renderDate(page, ticket.travelDate);
+            page << ',';
+            writeCsvField(page, train.stationName(ticket.fromStation));
+            page << ',';
+            writeCsvField(page, train.stationName(ticket.toStation));
+            page << ',';
+            ticket.renderStatus(page, train);
+            page << ',' << quotaName(ticket.quota) << ',';
+            writeCsvField(page, ticket.bookedByUsername());
+            page << ',';
+            writeCsvField(page, passenger.name);
+            page << ',' << passenger.age << ',' << passenger.gender << ',';
+            if (i < ticket.seats.size()) page << ticket.seats[i] + 1;
+            page << ',';
+            page.money(passenger.fare);
+            page.line();
+        }
+        return ticket.passengers.size();
+    };
+
+    std::size_t rows = 0;
+    if (handle != TrainIndex::npos) {
+        for (const Ticket* ticket : shards[0]) rows += render(out, *ticket);
+        return rows;
+    }
+    std::size_t wave = scheduler.workers();
+    for (std::size_t first = 0; first < shards.size(); first += wave) {
+        std::vector<std::string> pages(std::min(wave, shards.size() - first));
+        std::vector<std::size_t> counts(pages.size());
+        scheduler.parallelFor(pages.size(), [&](std::size_t i) {
+            OutputBuffer page(nullptr);
+            for (const Ticket* ticket : shards[first + i]) counts[i] += render(page, *ticket);
+            page.moveTo(pages[i]);
+        });
+        for (std::size_t i = 0; i < pages.size(); ++i) {
+            out << pages[i];
+            rows += counts[i];
+        }
+        out.flush();
+    }
+    return rows;
+}
+
+// --- Persistence ---
+
+std::string RailwayManager::snapshotPath() const {
+    return dataDir + "/railway.snap";
+}
+
+std::string RailwayManager::timetablePath() const {
+    return dataDir + "/timetable.bin";
+}
+
+std::string RailwayManager::journalPath(std::uint64_t gen) const {
+    return dataDir + "/railway-" + std::to_string(gen) + ".wal";
+}
+
+std::uint64_t RailwayManager::logEvent(const BinaryWriter& record) {
+    return journal ? journal->append(record.data()) : 0;
+}
+
+void RailwayManager::awaitDurable(std::uint64_t lsn) {
+    if (journal && lsn) {
+        journal->waitDurable(lsn);
+    }
+}
+
+/*
+ * Restores the latest snapshot, then replays journals from its generation
+ * onwards. Journal N holds every change made after snapshot N was taken;
+ * journal N+1 can also exist if a crash hit mid-checkpoint. Without a
+ * snapshot the base state is seedData's, which journal 1 extends. Returns
+ * false, with seed data loaded, if the snapshot is unreadable, and false if
+ * a journal is; either way the files are left for an operator to recover.
+ */
+bool RailwayManager::recover() {
+    auto problem = [](LoadStatus status) {
+        return status == LoadStatus::UnsupportedVersion ? " has an unsupported format version" : " is corrupt";
+    };
+    std::string contents;
+    std::uint64_t gen = 1;
+    if (readFile(snapshotPath(), contents)) {
+        LoadStatus status = loadSnapshot(contents, gen);
+        if (status != LoadStatus::Ok) {
+            std::cerr << "❌ Snapshot " << snapshotPath() << problem(status)
+                      << "; running from seed data without persistence." << std::endl;
+            seedData();
+            return false;
+        }
+    } else {
+        seedData();
+    }
+
+    std::size_t replayed = 0;
+    auto apply = [this](BinaryReader& in) { return applyJournalRecord(in); };
+    for (;; ++gen) {
+        std::ifstream probe(journalPath(gen), std::ios::binary);
+        if (!probe) break;
+        probe.close();
+        std::size_t applied;
+        LoadStatus status = WriteAheadLog::replay(journalPath(gen), gen, apply, applied);
+        replayed += applied;
+        if (status != LoadStatus::Ok) {
+            std::cerr << "❌ Journal " << journalPath(gen) << problem(status)
+                      << "; running without persistence, and without its changes." << std::endl;
+            return false;
+        }
+    }
+    generation = gen - 1;
+    if (replayed > 0) {
+        std::cout << "Recovered " << replayed << " journaled change(s)." << std::endl;
+    }
+    return true;
+}
+
+// Nothing is loaded unless the checksum and header match. The leading
+// timetable trains are listed only by number, fare and capacity and are
+// rebuilt from timetable.bin, found by number because compaction may have
+// rewritten the image with more trains since; the overlay is stored in
+// full. Each train's cancelled runs follow the catalog. The catalog is
+// appended in bulk and sorted once.
+LoadStatus RailwayManager::loadSnapshot(const std::string& contents, std::uint64_t& snapshotGeneration) {
+    if (contents.size() < sizeof(std::uint32_t)) return LoadStatus::Corrupt;
+    std::size_t bodySize = contents.size() - sizeof(std::uint32_t);
+    std::uint32_t checksum;
+    std::memcpy(&checksum, contents.data() + bodySize, sizeof(checksum));
+    if (crc32(contents.data(), bodySize) != checksum) return LoadStatus::Corrupt;
+
+    BinaryReader in(contents.data(), bodySize);
+    std::uint32_t magic, version, timetableCount, trainCount, userCount;
+    std::uint64_t seed, ticketCount;
+    PnrAllocator::Issued issued;
+    if (!in.get(magic) || magic != kSnapshotMagic || !in.get(version)) return LoadStatus::Corrupt;
+    if (version != kSnapshotVersion) return LoadStatus::UnsupportedVersion;
+    if (!in.get(snapshotGeneration) || !in.get(seed)) return LoadStatus::Corrupt;
+    for (std::uint64_t& count : issued) {
+        if (!in.get(count)) return LoadStatus::Corrupt;
+    }
+    if (!in.get(timetableCount) || !in.get(trainCount) || timetableCount > trainCount) return LoadStatus::Corrupt;
+    timetableTrains = timetableCount;
+    pnrAllocator.restore(seed, issued);
+    TimetableImage image;
+    if (timetableCount > 0 && !image.open(timetablePath())) return LoadStatus::Corrupt;
+    {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        trainIndex.reserve(trainCount);
+        columns.reserve(trainCount);
+        for (std::uint32_t i = 0; i < trainCount; ++i) {
+            TrainHandle handle = static_cast<TrainHandle>(trains.size());
+            if (i < timetableCount) {
+                std::int32_t number, seats;
+                std::int64_t fare;
+                if (!in.get(number) || !in.get(fare) || !in.get(seats)) return LoadStatus::Corrupt;
+                const TimetableImage::Record* r = image.find(number);
+                if (!r || !trainIndex.insert(number, handle)) return LoadStatus::Corrupt;
+                appendFromImage(image, *r, fare, seats);
+            } else {
+                std::optional<Train> train = readTrain(in);
+                if (!train || !trainIndex.insert(train->trainNumber, handle)) return LoadStatus::Corrupt;
+                trains.push_back(*train);
+                routeIndex.addTrain(handle, trains.back());
+                columns.append(trains.back());
+            }
+        }
+        for (Train& train : trains) {
+            std::uint32_t rangeCount;
+            if (!in.get(rangeCount)) return LoadStatus::Corrupt;
+            for (std::uint32_t i = 0; i < rangeCount; ++i) {
+                RunDate first, last;
+                if (!in.get(first) || !in.get(last)) return LoadStatus::Corrupt;
+                train.cancelRuns(first, last);
+            }
+        }
+        bookedTickets.trackTrains(trains.size());
+        sortViews.rebuild();
+        ++catalogVersion;
+    }
+    if (!in.get(userCount)) return LoadStatus::Corrupt;
+    for (std::uint32_t i = 0; i < userCount; ++i) {
+        std::string username, credential;
+        bool isAdmin;
+        if (!in.getString(username) || !in.getString(credential) || !in.get(isAdmin)) return LoadStatus::Corrupt;
+        NameId name = NamePool::instance().intern(username);
+        users.emplace(name, User(name, std::move(credential), isAdmin));
+    }
+    if (!in.get(ticketCount)) return LoadStatus::Corrupt;
+    for (std::uint64_t i = 0; i < ticketCount; ++i) {
+        std::optional<Ticket> ticket = readTicket(in);
+        if (!ticket || ticket->train >= trains.size() || !restoreTicket(*ticket)) return LoadStatus::Corrupt;
+        bookedTickets.insert(std::move(*ticket));
+    }
+    return LoadStatus::Ok;
+}
+
+// Re-applies one journaled change; false stops replay at a malformed record
+bool RailwayManager::applyJournalRecord(BinaryReader& in) {
+    JournalEvent event;
+    if (!in.get(event)) return false;
+    switch (event) {
+        case JournalEvent::AddTrain: {
+            // Already present if an earlier compaction put it in the timetable
+            std::optional<Train> train = readTrain(in);
+            if (!train) return false;
+            addTrain(*train);
+            return true;
+        }
+        case JournalEvent::SetFare: {
+            TrainHandle handle;
+            Paise fare;
+            if (!in.get(handle) || !in.get(fare) || handle >= trains.size()) return false;
+            setFare(handle, fare);
+            return true;
+        }
+        case JournalEvent::SetSeats: {
+            TrainHandle handle;
+            std::int32_t seats;
+            std::uint32_t count;
+            if (!in.get(handle) || !in.get(seats) || handle >= trains.size() || !in.get(count)) return false;
+            std::vector<std::pair<Pnr, SeatList>> moves;
+            for (std::uint32_t i = 0; i < count; ++i) {
+                Pnr pnr;
+                std::uint32_t seatCount;
+                if (!in.get(pnr) || !in.get(seatCount)) return false;
+                SeatList moved(seatCount);
+                for (std::uint32_t j = 0; j < seatCount; ++j) {
+                    std::int32_t seat;
+                    if (!in.get(seat)) return false;
+                    moved[j] = seat;
+                }
+                moves.emplace_back(pnr, std::move(moved));
+            }
+            std::vector<Pnr> cancelled;
+            if (!in.get(count)) return false;
+            for (std::uint32_t i = 0; i < count; ++i) {
+                Pnr pnr;
+                if (!in.get(pnr)) return false;
+                cancelled.push_back(pnr);
+            }
+            setCapacity(handle, seats);
+            Train& train = trains[handle];
+            // Live, a dropped ticket frees its seats for the tickets displaced
+            // after it, so every old seat goes back before any new one is taken
+            for (const Ticket& ticket : bookedTickets.extractAll(cancelled)) {
+                train.moveSeats(ticket.travelDate, ticket.seats, SeatList(), ticket.fromStation, ticket.toStation);
+            }
+            for (const auto& move : moves) {
+                bookedTickets.modify(move.first, [&train](Ticket& ticket) {
+                    train.moveSeats(ticket.travelDate, ticket.seats, SeatList(), ticket.fromStation, ticket.toStation);
+                });
+            }
+            bool consistent = true;
+            for (auto& move : moves) {
+                bookedTickets.modify(move.first, [&train, &move, &consistent](Ticket& ticket) {
+                    consistent &= train.moveSeats(ticket.travelDate, SeatList(), move.second, ticket.fromStation,
+                                                  ticket.toStation);
+                    ticket.seats = std::move(move.second);
+                });
+            }
+            return consistent; // A seat sold twice means the journal doesn't match this state
+        }
+        case JournalEvent::RegisterUser: {
+            std::string username, credential;
+            bool isAdmin;
+            if (!in.getString(username) || !in.getString(credential) || !in.get(isAdmin)) return false;
+            NameId name = NamePool::instance().intern(username);
+            users.emplace(name, User(name, std::move(credential), isAdmin));
+            return true;
+        }
+        case JournalEvent::Book: {
+            std::optional<Ticket> ticket = readTicket(in);
+            if (!ticket || ticket->train >= trains.size() ||
+                (ticket->status == TicketStatus::Confirmed && ticket->seats.size() != ticket->passengers.size())) {
+                return false;
+            }
+            // The same seats were free when this was journaled
+            restoreTicket(*ticket);
+            pnrAllocator.advancePast(ticket->pnr);
+            bookedTickets.insert(std::move(*ticket));
+            return true;
+        }
+        case JournalEvent::Cancel: {
+            Pnr pnr;
+            std::string username;
+            if (!in.get(pnr) || !in.getString(username)) return false;
+            if (std::optional<Ticket> ticket = bookedTickets.extract(pnr, NamePool::instance().find(username))) {
+                Train& train = trains[ticket->train];
+                if (ticket->status == TicketStatus::Waiting) {
+                    train.leaveWaitlist(ticket->travelDate, ticket->waitSeq);
+                } else {
+                    train.cancelSeats(ticket->travelDate, ticket->seats, ticket->fromStation, ticket->toStation);
+                }
+            }
+            return true;
+        }
+        case JournalEvent::Promote: {
+            Pnr pnr;
+            std::uint32_t count;
+            if (!in.get(pnr) || !in.get(count)) return false;
+            SeatList seats(count);
+            for (std::uint32_t i = 0; i < count; ++i) {
+                std::int32_t seat;
+                if (!in.get(seat)) return false;
+                seats[i] = seat;
+            }
+            bookedTickets.modify(pnr, [this, &seats](Ticket& ticket) {
+                if (ticket.status != TicketStatus::Waiting) return;
+                Train& train = trains[ticket.train];
+                train.leaveWaitlist(ticket.travelDate, ticket.waitSeq);
+                train.claimSeats(ticket.travelDate, seats, ticket.fromStation, ticket.toStation);
+                ticket.status = TicketStatus::Confirmed;
+                ticket.seats = std::move(seats);
+            });
+            return true;
+        }
+        case JournalEvent::CancelRuns: {
+            TrainHandle handle;
+            RunDate first, last;
+            std::uint32_t count;
+            if (!in.get(handle) || !in.get(first) || !in.get(last) || !in.get(count) || handle >= trains.size()) {
+                return false;
+            }
+            std::vector<Pnr> cancelled(count);
+            for (Pnr& pnr : cancelled) {
+                if (!in.get(pnr)) return false;
+            }
+            bookedTickets.extractAll(cancelled);
+            trains[handle].cancelRuns(first, last);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Gives a loaded ticket back its seats, or its place in the waiting list
+bool RailwayManager::restoreTicket(const Ticket& ticket) {
+    Train& train = trains[ticket.train];
+    if (ticket.status == TicketStatus::Waiting) {
+        return train.restoreWaiting(ticket.travelDate, ticket.waitSeq,
+                                    WaitQueue::Entry{ticket.pnr, static_cast<int>(ticket.passengers.size()),
+                                                     ticket.fromStation, ticket.toStation});
+    }
+    return train.claimSeats(ticket.travelDate, ticket.seats, ticket.fromStation, ticket.toStation);
+}
+
+/*
+ * Writes a snapshot of generation G+1 and switches the journal to G+1.
+ * State is captured and the journal rotated while every writer is locked
+ * out; the slow file write happens afterwards, with bookings flowing into
+ * the new journal. Until the new snapshot is in place, recovery still
+ * finds snapshot G plus journals G and G+1, so nothing is lost.
+ */
+bool RailwayManager::checkpoint() {
+    BinaryWriter out;
+    std::uint64_t gen;
+    {
+        std::unique_lock<std::shared_mutex> catalogLock(catalogMutex);
+        std::lock_guard<std::mutex> usersLock(usersMutex);
+        gen = generation + 1;
+
+        out.put(kSnapshotMagic);
+        out.put(kSnapshotVersion);
+        out.put(gen);
+        out.put(pnrAllocator.seed());
+        for (std::uint64_t count : pnrAllocator.issued()) out.put(count);
+        out.put(static_cast<std::uint32_t>(timetableTrains));
+        out.put(static_cast<std::uint32_t>(trains.size()));
+        for (std::size_t i = 0; i < trains.size(); ++i) {
+            const Train& train = trains[i];
+            if (i < timetableTrains) {
+                out.put<std::int32_t>(train.trainNumber); // The rest is in timetable.bin
+                out.put<std::int64_t>(train.fare.load());
+                out.put<std::int32_t>(train.totalSeats.load());
+            } else {
+                writeTrain(out, train);
+            }
+        }
+        for (const Train& train : trains) {
+            std::vector<std::pair<RunDate, RunDate>> ranges = train.cancelledRuns();
+            out.put(static_cast<std::uint32_t>(ranges.size()));
+            for (const auto& range : ranges) {
+                out.put(range.first);
+                out.put(range.second);
+            }
+        }
+        out.put(static_cast<std::uint32_t>(users.size()));
+        for (const auto& pair : users) {
+            out.putString(pair.second.username());
+            out.putString(pair.second.credential);
+            out.put(pair.second.isAdmin);
+        }
+        std::vector<const Ticket*> tickets;
+        bookedTickets.forEach([&tickets](const Ticket& ticket) { tickets.push_back(&ticket); });
+        out.put(static_cast<std::uint64_t>(tickets.size()));
+        for (const Ticket* ticket : tickets) {
+            writeTicket(out, *ticket);
+        }
+
+        if (!journal->rotate(journalPath(gen), gen)) {
+            std::cerr << "❌ Could not open journal " << journalPath(gen) << "." << std::endl;
+            return false;
+        }
+        generation = gen;
+    }
+
+    out.put(crc32(out.data().data(), out.data().size()));
+    std::string temp = snapshotPath() + ".tmp";
+    DurableFile file;
+    bool ok = file.open(temp, true) && file.write(out.data().data(), out.data().size()) && file.sync();
+    file.close();
+    if (!ok || std::rename(temp.c_str(), snapshotPath().c_str()) != 0) {
+        std::cerr << "❌ Could not write snapshot " << snapshotPath() << "." << std::endl;
+        return false;
+    }
+    syncDirectory(dataDir);
+
+    // Older journals are now covered by the snapshot
+    for (std::uint64_t old = gen - 1; old > 0; --old) {
+        if (std::remove(journalPath(old).c_str()) != 0) break;
+    }
+
+    // Compaction: merge the overlay of added trains into the timetable image
+    std::shared_lock<std::shared_mutex> catalogLock(catalogMutex);
+    if (trains.size() > timetableTrains) {
+        if (TimetableImage::write(timetablePath(), trains)) {
+            timetableTrains = trains.size();
+        } else {
+            std::cerr << "❌ Could not write timetable " << timetablePath() << "." << std::endl;
+        }
+    }
+    return true;
+}
+
+void RailwayManager::maybeCheckpoint() {
+    if (journal && journal->recordsInFile() >= kCheckpointEvery && !checkpointing.exchange(true)) {
+        checkpoint();
+        checkpointing = false;
+    }
+}
+
+// --- Bulk Import ---
+
+/*
+ * The stream is read a wave of blocks at a time, one block per worker, and
+ * each wave is parsed in parallel on the scheduler, so memory holds one
+ * wave of text rather than the whole file. parse fills in a Row from a
+ * row's fields, or returns why the row is rejected. Blank lines, and a
+ * first row naming the columns, are skipped.
+ */
+template <typename Row, typename Parse>
+void RailwayManager::parseCsvRows(std::istream& in, const char* header, std::vector<Row>& rows,
+                                  ImportResult& result, const Parse& parse) {
+    struct Part {
+        CsvChunker::Block block;
+        std::vector<Row> rows;
+        ImportResult result;
+    };
+    CsvChunker chunker(in);
+    std::vector<Part> wave(std::max<std::size_t>(1, scheduler.workers()));
+    for (bool more = true; more;) {
+        std::size_t count = 0;
+        while (count < wave.size() && (more = chunker.next(wave[count].block))) ++count;
+        scheduler.parallelFor(count, [&wave, header, &parse](std::size_t i) {
+            Part& part = wave[i];
+            std::vector<std::string> fields;
+            std::size_t line = part.block.firstLine;
+            for (std::size_t pos = 0; pos < part.block.text.size();) {
+                std::size_t rowLine = line;
+                pos = readCsvRow(part.block.text, pos, fields, line);
+                bool blank = fields.size() == 1 && fields[0].empty();
+                if (blank || (rowLine == 1 && fields[0] == header)) continue;
+                Row row;
+                row.line = rowLine;
+                if (const char* reason = parse(fields, row)) {
+                    part.result.reject(rowLine, reason);
+                } else {
+                    part.rows.push_back(std::move(row));
+                }
+            }
+        });
+        for (std::size_t i = 0; i < count; ++i) {
+            std::move(wave[i].rows.begin(), wave[i].rows.end(), std::back_inserter(rows));
+            wave[i].rows.clear();
+            result.absorb(wave[i].result);
+        }
+    }
+}
+
+// Every accepted row was journaled; a checkpoint then saves a restart from
+// replaying them one by one
+void RailwayManager::finishImport(std::uint64_t lsn, const ImportResult& result) {
+    awaitDurable(lsn);
+    if (journal && result.accepted > 0 && !checkpointing.exchange(true)) {
+        checkpoint();
+        checkpointing = false;
+    }
+}
+
+/*
+ * Rows are number,name,source,destination,fare,seats[,stops], the fare in
+ * rupees and the stops joined by '|' as in the timetable image. Parsed rows
+ * are added under one hold of the catalog lock, the train index and
+ * columns sized for all of them first, and the sort views are rebuilt once
+ * at the end, as loadTimetable does, instead of each train being inserted
+ * into them in turn.
+ */
+ImportResult RailwayManager::importTrains(std::istream& in) {
+    struct Row {
+        std::size_t line = 0;
+        int number = 0;
+        std::string name, source, destination;
+        Paise fare = 0;
+        int seats = 0;
+        std::vector<std::string> stops;
+    };
+    auto whole = [](const std::string& text, int& value) {
+        const char* end = text.data() + text.size();
+        return !text.empty() && std::from_chars(text.data(), end, value).ptr == end;
+    };
+    std::vector<Row> rows;
+    ImportResult result;
+    // Names end up in tab-separated batch responses and one-line screens
+    auto control = [](unsigned char c) { return c < ' ' || c == 0x7F; };
+    auto parse = [&whole, &control](const std::vector<std::string>& fields, Row& row) -> const char* {
+        if (fields.size() != 6 && fields.size() != 7) return "expected 6 or 7 fields";
+        if (!whole(fields[0], row.number) || row.number <= 0) return "bad train number";
+        if (fields[1].empty() || fields[2].empty() || fields[3].empty()) return "missing name or station";
+        for (std::size_t i = 1; i < fields.size(); ++i) {
+            if (i != 4 && i != 5 && std::any_of(fields[i].begin(), fields[i].end(), control)) {
+                return "control character in a name";
+            }
+        }
+        char* end = nullptr;
+        double rupees = std::strtod(fields[4].c_str(), &end);
+        if (fields[4].empty() || end != fields[4].c_str() + fields[4].size() || !std::isfinite(rupees) || rupees < 0) {
+            return "bad fare";
+        }
+        if (!whole(fields[5], row.seats) || row.seats <= 0) return "bad seat count";
+        if (fields.size() == 7 && !fields[6].empty()) {
+            std::istringstream joined(fields[6]);
+            for (std::string stop; std::getline(joined, stop, TimetableImage::kStopSeparator);) {
+                if (stop.empty()) return "empty stop";
+                row.stops.push_back(std::move(stop));
+            }
+        }
+        row.name = fields[1];
+        row.source = fields[2];
+        row.destination = fields[3];
+        row.fare = toPaise(rupees);
+        return nullptr;
+    };
+    parseCsvRows(in, "number", rows, result, parse);
+
+    std::uint64_t lsn = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        trainIndex.reserve(trains.size() + rows.size());
+        columns.reserve(trains.size() + rows.size());
+        for (Row& row : rows) {
+            TrainHandle handle = static_cast<TrainHandle>(trains.size());
+            if (!trainIndex.insert(row.number, handle)) {
+                result.reject(row.line, "train " + std::to_string(row.number) + " already exists");
+                continue;
+            }
+            trains.emplace_back(row.number, std::move(row.name), std::move(row.source), std::move(row.destination),
+                                row.fare, row.seats, std::move(row.stops));
+            routeIndex.addTrain(handle, trains.back());
+            columns.append(trains.back());
+            BinaryWriter record;
+            record.put(JournalEvent::AddTrain);
+            writeTrain(record, trains.back());
+            lsn = logEvent(record);
+            ++result.accepted;
+        }
+        if (result.accepted > 0) {
+            bookedTickets.trackTrains(trains.size());
+            sortViews.rebuild();
+            ++catalogVersion;
+        }
+    }
+    finishImport(lsn, result);
+    return result;
+}
+
+/*
+ * Rows are username,password[,role], role being user (the default) or
+ * admin. A password already in PasswordHasher's credential format, as
+ * exported from another system, is kept as it is. Any other is hashed at
+ * the current cost on the parsing workers, which is where a large import
+ * of plain passwords spends its time, and names are interned there too.
+ * Accepted rows are sorted by NameId, so duplicates in the file sit side by
+ * side, and merged into the user map, sized for them first, under one hold
+ * of usersMutex.
+ */
+ImportResult RailwayManager::importUsers(std::istream& in) {
+    struct Row {
+        std::size_t line = 0;
+        NameId name = 0;
+        std::string credential;
+        bool admin = false;
+    };
+    std::uint32_t cost = passwordCost;
+    std::vector<Row> rows;
+    ImportResult result;
+    auto parse = [cost](const std::vector<std::string>& fields, Row& row) -> const char* {
+        if (fields.size() != 2 && fields.size() != 3) return "expected 2 or 3 fields";
+        const std::string& name = fields[0];
+        auto unprintable = [](unsigned char c) { return c <= ' ' || c == 0x7F; }; // Names are read as words
+        if (name.empty() || std::any_of(name.begin(), name.end(), unprintable)) return "bad username";
+        if (fields[1].empty()) return "missing password";
+        if (fields.size() == 3 && !fields[2].empty() && fields[2] != "user" && fields[2] != "admin") return "bad role";
+        bool hashed = fields[1].compare(0, 14, "pbkdf2-sha256$") == 0;
+        if (hashed && !PasswordHasher::wellFormed(fields[1])) return "bad credential";
+        row.name = NamePool::instance().intern(name);
+        row.credential = hashed ? fields[1] : PasswordHasher::hash(fields[1], cost);
+        row.admin = fields.size() == 3 && fields[2] == "admin";
+        return nullptr;
+    };
+    parseCsvRows(in, "username", rows, result, parse);
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.name < b.name; });
+
+    std::uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        users.reserve(users.size() + rows.size());
+        const Row* first = nullptr; // Of the rows with this name
+        for (Row& row : rows) {
+            if (first && row.name == first->name) {
+                result.reject(row.line, "duplicate of line " + std::to_string(first->line));
+                continue;
+            }
+            first = &row;
+            const std::string& username = NamePool::instance().text(row.name);
+            if (!users.emplace(row.name, User(row.name, row.credential, row.admin)).second) {
+                result.reject(row.line, "user " + username + " already exists");
+                continue;
+            }
+            BinaryWriter record;
+            record.put(JournalEvent::RegisterUser);
+            record.putString(username);
+            record.putString(row.credential);
+            record.put(row.admin);
+            lsn = logEvent(record);
+            ++result.accepted;
+        }
+    }
+    finishImport(lsn, result);
+    return result;
+}
+
+// --- Login and Registration ---
+bool RailwayManager::login() {
+    printHeader("LOGIN");
+    std::string username, password;
+    std::cout << "Enter username: ";
+    std::cin >> username;
+    std::cout << "Enter password: ";
+    std::cin >> password;
+
+    if ((currentUser = authenticate(username, password))) {
+        std::cout << "\n✅ Login successful! Welcome, " << currentUser->username() << "." << std::endl;
+        return true;
+    }
+
+    std::cout << "\n❌ Invalid username or password." << std::endl;
+    return false;
+}
+
+void RailwayManager::registerUser() {
+    printHeader("REGISTER NEW USER");
+    std::string username, password;
+    std::cout << "Enter new username: ";
+    std::cin >> username;
+
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        if (users.count(NamePool::instance().find(username))) {
+            std::cout << "\n❌ Username already exists. Please try another." << std::endl;
+            return;
+        }
+    }
+
+    std::cout << "Enter new password: ";
+    std::cin >> password;
+    if (!addUser(username, password)) {
+        std::cout << "\n❌ Username already exists. Please try another." << std::endl;
+        return;
     }
-
-    std::cout << "Enter new password: ";
-    std::cin >> password;
-    users.emplace(username, User(username, password));
     std::cout << "\n✅ User '" << username << "' registered successfully. Please login." << std::endl;
 }
 
 // --- Main Application Loop ---
 void RailwayManager::run() {
     while (true) {
-        clearScreen();
-        printHeader("RAILWAY MANAGEMENT SYSTEM");
-        std::cout << "1. Login\n";
-        std::cout << "2. Register\n";
-        std::cout << "3. Exit\n";
-        std::cout << "Enter your choice: ";
+        OutputBuffer menu;
+        printHeader(menu, "RAILWAY MANAGEMENT SYSTEM");
+        menu << "1. Login\n";
+        menu << "2. Register\n";
+        menu << "3. Exit\n";
+        menu << "Enter your choice: ";
+        Terminal::instance().present(menu.take());
         int choice;
         std::cin >> choice;
 
@@ -342,27 +6659,34 @@ void RailwayManager::run() {
 void RailwayManager::adminDashboard() {
     int choice;
     do {
-        clearScreen();
-        printHeader("ADMIN DASHBOARD");
-        std::cout << "1. Add New Train\n";
-        std::cout << "2. Modify Existing Train\n";
-        std::cout << "3. View All Booked Tickets\n";
-        std::cout << "4. Logout\n";
-        std::cout << "Enter your choice: ";
+        OutputBuffer menu;
+        printHeader(menu, "ADMIN DASHBOARD");
+        menu << "1. Add New Train\n";
+        menu << "2. Modify Existing Train\n";
+        menu << "3. View All Booked Tickets\n";
+        menu << "4. Cancel a Train Run\n";
+        menu << "5. Reports\n";
+        menu << "6. Bulk Import Trains or Users\n";
+        menu << "7. Logout\n";
+        menu << "Enter your choice: ";
+        Terminal::instance().present(menu.take());
         std::cin >> choice;
 
         switch (choice) {
             case 1: addNewTrain(); break;
             case 2: modifyTrain(); break;
             case 3: viewAllSystemTickets(); break;
-            case 4: 
+            case 4: cancelTrainRun(); break;
+            case 5: reportsMenu(); break;
+            case 6: bulkImport(); break;
+            case 7: 
                 currentUser = nullptr; 
                 std::cout << "\nLogging out..." << std::endl;
                 break;
             default: std::cout << "\nInvalid choice." << std::endl; break;
         }
-        if (choice != 4) pressEnterToContinue();
-    } while (choice != 4);
+        if (choice != 7) pressEnterToContinue();
+    } while (choice != 7);
 }
 
 void RailwayManager::addNewTrain() {
@@ -372,38 +6696,94 @@ void RailwayManager::addNewTrain() {
     double fare;
 
     std::cout << "Enter Train Number: "; std::cin >> num;
+    if (seatsLeft(num, currentDate()) != -1) {
+        std::cout << "\n❌ A train with number " << num << " already exists." << std::endl;
+        return;
+    }
     std::cout << "Enter Train Name: "; std::getline(std::cin >> std::ws, name);
     std::cout << "Enter Source: "; std::getline(std::cin >> std::ws, src);
     std::cout << "Enter Destination: "; std::getline(std::cin >> std::ws, dest);
+    std::cout << "Enter Intermediate Stops in order (comma-separated, blank for none): ";
+    std::string line;
+    std::getline(std::cin, line);
+    std::vector<std::string> stops;
+    std::istringstream list(line);
+    for (std::string stop; std::getline(list >> std::ws, stop, ',');) {
+        stop.erase(stop.find_last_not_of(" \t") + 1);
+        if (!stop.empty()) stops.push_back(stop);
+    }
     std::cout << "Enter Fare: "; std::cin >> fare;
     std::cout << "Enter Total Seats: "; std::cin >> seats;
 
-    trains.emplace_back(num, name, src, dest, fare, seats);
+    if (!addTrain(Train(num, name, src, dest, toPaise(fare), seats, stops))) {
+        std::cout << "\n❌ A train with number " << num << " already exists." << std::endl;
+        return;
+    }
     std::cout << "\n✅ Train '" << name << "' added successfully." << std::endl;
 }
 
+void RailwayManager::bulkImport() {
+    printHeader("BULK IMPORT");
+    std::cout << "Import: 1. Trains 2. Users\nEnter choice: ";
+    int choice;
+    std::cin >> choice;
+    if (choice != 1 && choice != 2) {
+        std::cout << "\nInvalid choice." << std::endl;
+        return;
+    }
+    std::cout << (choice == 1 ? "Columns: number,name,source,destination,fare,seats[,stops joined by |]\n"
+                              : "Columns: username,password[,role]\n");
+    std::cout << "CSV file: ";
+    std::string path;
+    std::getline(std::cin >> std::ws, path);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "\n❌ Cannot open " << path << "." << std::endl;
+        return;
+    }
+    ImportResult result = choice == 1 ? importTrains(file) : importUsers(file);
+    OutputBuffer out;
+    out.line();
+    result.render(out, choice == 1 ? "train(s)" : "user(s)");
+}
+
 void RailwayManager::modifyTrain() {
     printHeader("MODIFY TRAIN DETAILS");
     std::cout << "Enter Train Number to modify: ";
     int trainNum;
     std::cin >> trainNum;
 
-    // Searching using a standard loop with an iterator
-    auto it = std::find_if(trains.begin(), trains.end(), 
-        [trainNum](const Train& t) { return t.trainNumber == trainNum; });
-    
-    if (it == trains.end()) {
-        std::cout << "\n❌ Train not found." << std::endl;
-        return;
+    // Hashed lookup through the train index
+    TrainHandle handle;
+    {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        handle = trainIndex.find(trainNum);
+        if (handle == TrainIndex::npos) {
+            std::cout << "\n❌ Train not found." << std::endl;
+            return;
+        }
+        std::cout << "\nFound Train (seats for today): ";
+        const Train& found = trains[handle];
+        found.display(found.seatsFree(currentDate(), 0, found.segments()));
     }
-    
-    std::cout << "\nFound Train: ";
-    it->display(true);
+
+    // Handles are stable, so the train can be re-found without a lookup.
+    // The catalog is only locked exclusively while applying each change.
     std::cout << "\nEnter new fare (or -1 to keep current): ";
     double newFare;
     std::cin >> newFare;
     if (newFare != -1) {
-        it->fare = newFare;
+        std::uint64_t lsn;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            setFare(handle, toPaise(newFare));
+            BinaryWriter record;
+            record.put(JournalEvent::SetFare);
+            record.put(handle);
+            record.put(toPaise(newFare));
+            lsn = logEvent(record);
+        }
+        awaitDurable(lsn);
         std::cout << "Fare updated." << std::endl;
     }
 
@@ -411,38 +6791,208 @@ void RailwayManager::modifyTrain() {
     int newSeats;
     std::cin >> newSeats;
     if (newSeats != -1) {
-        it->totalSeats = newSeats;
-        it->availableSeats = newSeats; // Reset available seats
+        TrainChangeResult changed;
+        resizeTrain(trainNum, newSeats, changed); // Sales on remaining seats are kept
         std::cout << "Seat capacity updated." << std::endl;
+        if (changed.reseated > 0) {
+            std::cout << changed.reseated << " ticket(s) on removed seats were given other seats." << std::endl;
+        }
+        if (changed.cancelled > 0) {
+            std::cout << "❌ " << changed.cancelled << " ticket(s) (" << changed.passengers
+                      << " passengers) could not be reseated and were cancelled." << std::endl;
+        }
     }
     
     std::cout << "\n✅ Train details modified." << std::endl;
 }
 
+void RailwayManager::cancelTrainRun() {
+    printHeader("CANCEL A TRAIN RUN");
+    std::cout << "Enter Train Number: ";
+    int trainNum;
+    std::cin >> trainNum;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    std::cout << "Date of the run to cancel (YYYY-MM-DD, blank for today): ";
+    std::string text;
+    std::getline(std::cin, text);
+    RunDate date = currentDate();
+    if (!text.empty() && !parseDate(text, date)) {
+        std::cout << "\n❌ Dates are written as YYYY-MM-DD." << std::endl;
+        return;
+    }
+
+    TrainChangeResult cancelled;
+    if (!cancelTrainRuns(trainNum, date, date, cancelled)) {
+        std::cout << "\n❌ Train not found." << std::endl;
+        return;
+    }
+    std::cout << "\n✅ Run cancelled: " << cancelled.cancelled << " ticket(s) for " << cancelled.passengers
+              << " passengers were cancelled." << std::endl;
+}
+
+// Renders rows and their overall totals; the occupancy column only when the rows have it
+void renderReport(OutputBuffer& out, const std::vector<ReportRow>& rows, const TicketAggregates::Values& overall,
+                  bool withOccupancy) {
+    using Totals = TicketAggregates;
+    out.left("Train", 8).left("Name", 26).left("Tickets", 10).left("Pax", 8).left("Waiting", 9) << "Revenue";
+    if (withOccupancy) out << "       Occupancy";
+    out.line();
+    out.repeat('-', withOccupancy ? 88 : 72).line();
+    for (const ReportRow& row : rows) {
+        out.left(row.trainNumber, 8).left(row.trainName.substr(0, 25), 26);
+        out.left(row.totals[Totals::Tickets], 10).left(row.totals[Totals::Passengers], 8);
+        out.left(row.totals[Totals::Waiting], 9);
+        std::size_t start = out.size();
+        out.money(row.totals[Totals::RevenuePaise]).padFrom(start, 14);
+        if (withOccupancy && row.occupancy.seatCapacity > 0) {
+            out << "  " << (100 * row.occupancy.seatsHeld / row.occupancy.seatCapacity) << "% of "
+                << row.occupancy.seatCapacity;
+        }
+        out.line();
+    }
+    out.repeat('-', withOccupancy ? 88 : 72).line();
+    out << "Total: " << overall[Totals::Tickets] << " tickets, " << overall[Totals::Passengers] << " passengers ("
+        << overall[Totals::Waiting] << " waiting), revenue ";
+    out.money(overall[Totals::RevenuePaise]).line();
+    out << "Passengers by gender: " << overall[Totals::Male] << " M, " << overall[Totals::Female] << " F, "
+        << overall[Totals::OtherGender] << " other";
+    out.line();
+    out << "By age: " << overall[Totals::Children] << " under 12, " << overall[Totals::Youths] << " 12-17, "
+        << overall[Totals::Adults] << " 18-59, " << overall[Totals::Seniors] << " 60+";
+    out.line();
+}
+
+void RailwayManager::reportsMenu() {
+    printHeader("REPORTS");
+    std::cout << "1. Live Revenue & Occupancy Dashboard\n"
+              << "2. Revenue & Demographics for a Date Range\n"
+              << "3. Export Tickets to CSV\n"
+              << "Enter your choice: ";
+    int choice;
+    std::cin >> choice;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    TicketAggregates::Values overall;
+    if (choice == 1) {
+        OutputBuffer out;
+        std::vector<ReportRow> rows = dashboard(overall);
+        out << '\n';
+        renderReport(out, rows, overall, true);
+        return;
+    }
+    if (choice != 2 && choice != 3) {
+        std::cout << "\nInvalid choice." << std::endl;
+        return;
+    }
+
+    ReportQuery query;
+    std::string text;
+    std::cout << "Train Number (blank for all trains): ";
+    std::getline(std::cin, text);
+    query.trainNumber = std::atoi(text.c_str());
+    std::cout << "From date (YYYY-MM-DD, blank for the first): ";
+    std::getline(std::cin, text);
+    if (!text.empty() && !parseDate(text, query.firstDate)) {
+        std::cout << "\n❌ Dates are written as YYYY-MM-DD." << std::endl;
+        return;
+    }
+    std::cout << "To date (YYYY-MM-DD, blank for the last): ";
+    std::getline(std::cin, text);
+    if (!text.empty() && !parseDate(text, query.lastDate)) {
+        std::cout << "\n❌ Dates are written as YYYY-MM-DD." << std::endl;
+        return;
+    }
+
+    if (choice == 2) {
+        OutputBuffer out;
+        std::vector<ReportRow> rows = runReport(query, overall);
+        out << '\n';
+        renderReport(out, rows, overall, false);
+        return;
+    }
+    std::cout << "Export to file: ";
+    std::getline(std::cin, text);
+    std::ofstream file(text);
+    if (!file) {
+        std::cout << "\n❌ Cannot write " << text << std::endl;
+        return;
+    }
+    std::size_t rows = exportTickets(query, file);
+    file.close();
+    if (!file) {
+        std::cout << "\n❌ Writing " << text << " failed." << std::endl;
+        return;
+    }
+    std::cout << "\n✅ Exported " << rows << " passenger row(s) to " << text << std::endl;
+}
+
 void RailwayManager::viewAllSystemTickets() {
     printHeader("ALL BOOKED TICKETS");
     if (bookedTickets.empty()) {
         std::cout << "No tickets have been booked in the system yet." << std::endl;
         return;
     }
-    for (const auto& pair : bookedTickets) {
-        pair.second.display();
+    std::cout << "Enter Train Number to filter by (0 for all trains): ";
+    int trainNum;
+    std::cin >> trainNum;
+
+    // Rendered from snapshots, holding no lock that bookings need; the pin
+    // taken here covers the workers too
+    EpochDomain::Guard pinned(readEpochs);
+    // The whole report goes through one buffer, written out in 64 KiB chunks
+    OutputBuffer out;
+    if (trainNum == 0) {
+        // Every shard is captured before rendering starts, so the report shows
+        // each shard as it was at one moment, while bookings carry on
+        std::vector<TicketStore::Snapshot> shards(TicketStore::kShards);
+        for (std::size_t i = 0; i < shards.size(); ++i) bookedTickets.snapshotShard(i, shards[i]);
+        const CatalogSnapshot& catalog = catalogSnapshot();
+        // Shards are sorted by PNR and rendered in parallel, a wave of one per
+        // worker at a time, and printed in shard order
+        std::size_t wave = scheduler.workers();
+        for (std::size_t first = 0; first < shards.size(); first += wave) {
+            std::vector<std::string> pages(std::min(wave, shards.size() - first));
+            scheduler.parallelFor(pages.size(), [first, &pages, &shards, &catalog](std::size_t i) {
+                TicketStore::Snapshot& tickets = shards[first + i];
+                std::sort(tickets.begin(), tickets.end(), [](const Ticket* a, const Ticket* b) { return a->pnr < b->pnr; });
+                OutputBuffer page(nullptr);
+                for (const Ticket* ticket : tickets) ticket->render(page, catalog.train(ticket->train));
+                page.moveTo(pages[i]);
+            });
+            for (const std::string& page : pages) out << page;
+            out.flush();
+        }
+        return;
+    }
+    TrainHandle handle;
+    {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex); // Only for the lookup
+        handle = trainIndex.find(trainNum);
     }
+    if (handle == TrainIndex::npos) {
+        std::cout << "\n❌ Train not found." << std::endl;
+        return;
+    }
+    // Per-train manifest from the secondary index, not a scan of every ticket
+    TicketStore::Snapshot manifest = bookedTickets.snapshotOnTrain(handle);
+    const CatalogSnapshot& catalog = catalogSnapshot();
+    for (const Ticket* ticket : manifest) ticket->render(out, catalog.train(ticket->train));
 }
 
 // --- User Dashboard & Functions ---
 void RailwayManager::userDashboard() {
     int choice;
     do {
-        clearScreen();
-        printHeader("USER DASHBOARD");
-        std::cout << "Welcome, " << currentUser->username << "!\n\n";
-        std::cout << "1. View and Sort Available Trains\n";
-        std::cout << "2. Book a Ticket\n";
-        std::cout << "3. View My Tickets\n";
-        std::cout << "4. Cancel a Ticket\n";
-        std::cout << "5. Logout\n";
-        std::cout << "Enter your choice: ";
+        OutputBuffer menu;
+        printHeader(menu, "USER DASHBOARD");
+        menu << "Welcome, " << currentUser->username() << "!\n\n";
+        menu << "1. View and Sort Available Trains\n";
+        menu << "2. Book a Ticket\n";
+        menu << "3. View My Tickets\n";
+        menu << "4. Cancel a Ticket\n";
+        menu << "5. Search Journeys by Station\n";
+        menu << "6. Logout\n";
+        menu << "Enter your choice: ";
+        Terminal::instance().present(menu.take());
         std::cin >> choice;
 
         switch (choice) {
@@ -450,14 +7000,59 @@ void RailwayManager::userDashboard() {
             case 2: bookTicket(); break;
             case 3: viewMyTickets(); break;
             case 4: cancelTicket(); break;
-            case 5: 
+            case 5: searchJourneys(); break;
+            case 6: 
                 currentUser = nullptr;
                 std::cout << "\nLogging out..." << std::endl;
                 break;
             default: std::cout << "\nInvalid choice." << std::endl; break;
         }
-        if (choice != 5) pressEnterToContinue();
-    } while (choice != 5);
+        if (choice != 6) pressEnterToContinue();
+    } while (choice != 6);
+}
+
+void RailwayManager::searchJourneys() {
+    printHeader("SEARCH JOURNEYS");
+    std::string from, to;
+    int maxTransfers;
+    std::cout << "From Station: "; std::getline(std::cin >> std::ws, from);
+    std::cout << "To Station: "; std::getline(std::cin >> std::ws, to);
+    std::cout << "Maximum changes (0-" << RouteIndex::kMaxTransfers << "): "; std::cin >> maxTransfers;
+
+    std::vector<std::vector<JourneyLeg>> journeys = findJourneys(from, to, maxTransfers, 10);
+    if (journeys.empty()) {
+        std::cout << "\nNo journeys found from " << from << " to " << to << "." << std::endl;
+        return;
+    }
+    OutputBuffer out;
+    for (std::size_t i = 0; i < journeys.size(); ++i) {
+        out.line() << "Option " << i + 1 << " (" << journeys[i].size() - 1 << " change"
+                   << (journeys[i].size() == 2 ? "" : "s") << "):";
+        out.line();
+        for (const JourneyLeg& leg : journeys[i]) {
+            out << "  ";
+            out.left(leg.trainNumber, 7).left(leg.trainName, 20) << leg.from << " -> " << leg.to;
+            out.line();
+        }
+    }
+}
+
+// Reads a travel date on its own line; blank means today
+bool RailwayManager::promptTravelDate(RunDate& date) {
+    std::string text;
+    std::cout << "Travel Date (YYYY-MM-DD, blank for today): ";
+    std::getline(std::cin, text);
+    date = currentDate();
+    if (!text.empty() && !parseDate(text, date)) {
+        std::cout << "\n❌ Dates are written as YYYY-MM-DD." << std::endl;
+        return false;
+    }
+    if (!bookable(date)) {
+        std::cout << "\n❌ Tickets can be booked from today up to " << kAdvanceBookingDays
+                  << " days ahead." << std::endl;
+        return false;
+    }
+    return true;
 }
 
 void RailwayManager::viewAndSortTrains() {
@@ -465,24 +7060,67 @@ void RailwayManager::viewAndSortTrains() {
     std::cout << "Sort by: 1. Train Number (default) 2. Fare 3. Train Name\nEnter choice: ";
     int sortChoice;
     std::cin >> sortChoice;
+    std::cout << "Trains per page (0 for all): ";
+    int pageSize;
+    std::cin >> pageSize;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    RunDate date;
+    if (!promptTravelDate(date)) {
+        return;
+    }
+    TrainFilter filter;
+    filter.date = date;
+    std::string line;
+    std::cout << "Fare range as 'min max' (blank for any): "; std::getline(std::cin, line);
+    std::istringstream range(line);
+    double rupees;
+    if (range >> rupees) filter.minFare = toPaise(rupees);
+    if (range >> rupees) filter.maxFare = toPaise(rupees);
+    std::cout << "Minimum free seats (blank for any): "; std::getline(std::cin, line);
+    std::istringstream(line) >> filter.minSeats;
 
-    // Using STL algorithm (sort) with different lambda functions for schedule optimization/viewing
-    std::sort(trains.begin(), trains.end(), [sortChoice](const Train& a, const Train& b) {
-        if (sortChoice == 2) return a.fare < b.fare;
-        if (sortChoice == 3) return a.trainName < b.trainName;
-        return a.trainNumber < b.trainNumber; // Default
-    });
+    // Walk a cached, pre-sorted permutation; the master list is never reordered
+    TrainSortKey key = TrainSortKey::Number; // Default
+    if (sortChoice == 2) key = TrainSortKey::Fare;
+    if (sortChoice == 3) key = TrainSortKey::Name;
+    // Handles are stable, so the filtered view stays valid while paging.
+    // Pins never span the prompts: a page is read under a pin of its own.
+    std::vector<TrainHandle> order;
+    {
+        EpochDomain::Guard pinned(readEpochs);
+        order = filteredView(catalogSnapshot(), key, filter, 0);
+    }
+    if (order.empty()) {
+        std::cout << "\nNo trains match." << std::endl;
+        return;
+    }
+    std::size_t page = pageSize > 0 ? static_cast<std::size_t>(pageSize) : order.size();
 
-    std::cout << "\n" << std::left << std::setw(10) << "Train No."
-              << std::setw(25) << "Train Name"
-              << std::setw(20) << "Source"
-              << std::setw(20) << "Destination"
-              << std::setw(15) << "Fare"
-              << "Seats Available" << std::endl;
-    std::cout << std::string(110, '-') << std::endl;
+    OutputBuffer out;
+    out.line();
+    out.left("Train No.", 10).left("Train Name", 25).left("Source", 20).left("Destination", 20).left("Fare", 15)
+        << "Seats on ";
+    renderDate(out, date);
+    out.line().repeat('-', 110).line();
 
-    for (const auto& train : trains) {
-        train.display(true);
+    for (std::size_t start = 0; start < order.size(); start += page) {
+        std::size_t end = std::min(order.size(), start + page);
+        {
+            EpochDomain::Guard pinned(readEpochs);
+            const CatalogSnapshot& catalog = catalogSnapshot();
+            for (std::size_t i = start; i < end; ++i) {
+                const Train& train = catalog.train(order[i]);
+                train.render(out, train.seatsFree(date, 0, train.segments()));
+            }
+        }
+        // One write per page, then the prompt
+        out.flush();
+        if (end == order.size()) break;
+        std::cout << "-- Showing " << end << " of " << order.size()
+                  << ". Enter 'n' for the next page, anything else to stop: ";
+        char next;
+        std::cin >> next;
+        if (next != 'n' && next != 'N') break;
     }
 }
 
@@ -492,47 +7130,93 @@ void RailwayManager::bookTicket() {
     int trainNum;
     std::cin >> trainNum;
 
-    // Using STL algorithm (find_if) for searching
-    auto it = std::find_if(trains.begin(), trains.end(), 
-        [trainNum](const Train& t) { return t.trainNumber == trainNum; });
-
-    if (it == trains.end()) {
+    // O(1) hashed lookup instead of a linear scan
+    if (seatsLeft(trainNum, currentDate()) < 0) {
         std::cout << "\n❌ Invalid Train Number." << std::endl;
         return;
     }
 
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    RunDate date;
+    if (!promptTravelDate(date)) {
+        return;
+    }
+    // Seats are sold per leg, so a seat can be resold after the passenger alights
+    std::string from, to;
+    std::cout << "Boarding Station (blank for the train's source): "; std::getline(std::cin, from);
+    std::cout << "Destination Station (blank for the train's destination): "; std::getline(std::cin, to);
+    int available = seatsLeft(trainNum, date, from, to);
+    if (available < 0) {
+        std::cout << "\n❌ This train does not run from " << (from.empty() ? "its source" : from)
+                  << " to " << (to.empty() ? "its destination" : to) << "." << std::endl;
+        return;
+    }
+
     std::cout << "Enter number of passengers: ";
     int numPassengers;
     std::cin >> numPassengers;
-    
-    if (!it->bookSeats(numPassengers)) {
-        std::cout << "\n❌ Not enough seats available. Only " << it->availableSeats << " left." << std::endl;
+    if (numPassengers <= 0) {
+        std::cout << "\n❌ A booking needs at least one passenger." << std::endl;
         return;
     }
+    // Early check so passenger details aren't collected for a full train
+    // unless they are to wait; placeBooking makes the authoritative decision.
+    bool joinWaitlist = false;
+    if (numPassengers > available) {
+        std::cout << "\n❌ Not enough seats available. Only " << available << " left." << std::endl;
+        std::cout << "Join the waiting list instead? (y/n): ";
+        char answer;
+        std::cin >> answer;
+        if (answer != 'y' && answer != 'Y') return;
+        joinWaitlist = true;
+    }
+    std::cout << "Quota: 1. General (default) 2. Tatkal\nEnter choice: ";
+    int quotaChoice;
+    std::cin >> quotaChoice;
+    Quota quota = quotaChoice == 2 ? Quota::Tatkal : Quota::General;
 
-    int pnr = generatePNR();
-    Ticket newTicket(pnr, *it, currentUser->username);
+    PassengerList passengers(numPassengers);
     for (int i = 0; i < numPassengers; ++i) {
         std::cout << "\nEnter details for Passenger " << i + 1 << ":" << std::endl;
-        Passenger p;
-        p.getDetails();
-        newTicket.addPassenger(p);
+        passengers[i].getDetails();
     }
 
-    bookedTickets.emplace(pnr, newTicket);
-    std::cout << "\n✅ Ticket booked successfully!" << std::endl;
-    newTicket.display();
+    BookingResult result = placeBooking(trainNum, date, std::move(passengers), currentUser->username(), from, to,
+                                        joinWaitlist, quota);
+    if (result.status == BookingStatus::NotEnoughSeats) {
+        std::cout << "\n❌ Not enough seats available. Only " << result.seatsLeft << " left";
+        std::cout << (joinWaitlist ? ", and the waiting list is full." : ".") << std::endl;
+        return;
+    }
+    if (result.status == BookingStatus::RunCancelled) {
+        std::cout << "\n❌ This run of the train has been cancelled." << std::endl;
+        return;
+    }
+    if (result.status == BookingStatus::Waitlisted) {
+        std::cout << "\n✅ Ticket waitlisted: " << (result.waitClass == WaitClass::Rac ? "RAC " : "WL ")
+                  << result.waitPlace << ". It is confirmed automatically when seats are freed." << std::endl;
+    } else if (result.status != BookingStatus::Booked) {
+        std::cout << "\n❌ Booking failed." << std::endl;
+        return;
+    } else {
+        std::cout << "\n✅ Ticket booked successfully!" << std::endl;
+    }
+    if (std::optional<Ticket> ticket = bookedTickets.find(result.pnr)) {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        ticket->display(trains[ticket->train]);
+    }
 }
 
 void RailwayManager::viewMyTickets() {
     printHeader("MY BOOKED TICKETS");
     bool found = false;
-    for (const auto& pair : bookedTickets) {
-        if (pair.second.bookedByUsername == currentUser->username) {
-            pair.second.display();
-            found = true;
-        }
-    }
+    OutputBuffer out;
+    // Only this user's PNRs are visited, via the per-user index
+    listUserTickets(currentUser->username(), [&found, &out](const Ticket& ticket, const Train& train) {
+        ticket.render(out, train);
+        found = true;
+    });
+    out.flush();
     if (!found) {
         std::cout << "You have not booked any tickets yet." << std::endl;
     }
@@ -541,37 +7225,1229 @@ void RailwayManager::viewMyTickets() {
 void RailwayManager::cancelTicket() {
     printHeader("CANCEL TICKET");
     std::cout << "Enter PNR Number to cancel: ";
-    int pnr;
+    Pnr pnr;
     std::cin >> pnr;
 
-    // Using std::map's efficient find method
-    auto it = bookedTickets.find(pnr);
-    if (it == bookedTickets.end() || it->second.bookedByUsername != currentUser->username) {
+    // The store checks ownership and removes the ticket in one step
+    if (!cancelBooking(pnr, currentUser->username())) {
         std::cout << "\n❌ Invalid PNR or you are not authorized to cancel this ticket." << std::endl;
         return;
     }
-    
-    int trainNumToUpdate = it->second.trainDetails.trainNumber;
-    int seatsToReturn = it->second.passengers.size();
-    
-    bookedTickets.erase(it);
 
-    // Find the original train and restore the seat count
-    auto trainIt = std::find_if(trains.begin(), trains.end(), 
-        [trainNumToUpdate](const Train& t) { return t.trainNumber == trainNumToUpdate; });
-    
-    if (trainIt != trains.end()) {
-        trainIt->cancelSeats(seatsToReturn);
+    std::cout << "\n✅ Ticket with PNR " << pnr << " has been successfully cancelled." << std::endl;
+}
+
+// =====================================================================
+// BATCH MODE
+// =====================================================================
+
+/**
+ * @class BatchRunner
+ * @brief Headless front end that drives the booking core from a script.
+ * Reads one command per line and writes tab-separated responses, so that
+ * recorded traffic can be replayed and timed without any UI prompts.
+ *
+ *   LOGIN <user> <password>          REGISTER <user> <password>
+ *   RESUME <token>                   LOGOUT
+ *   BOOK <train> <n> <name:age:gender>... [<from> <to>] [WAIT] [TATKAL]
+ *   CANCEL <pnr>                     MYTICKETS
+ *   LIST [number|fare|name] [limit] [fare=<min>-<max>] [seats=<n>]
+ *   SEARCH <from> <to> [maxChanges]  ('_' stands for a space in station names)
+ *   DATE <YYYY-MM-DD|+days>          Travel date for later BOOK and LIST; default today
+ *   STATS                            Request scheduler counters
+ *   METRICS                          Latency histograms, counters and gauges
+ *   REPORT [train] [<from> <to>]     Ticket totals per train: live, or over a date range
+ *
+ * LOGIN answers with a session token. RESUME picks that session up again
+ * (on a new connection, say) without re-running the password KDF, and
+ * every BOOK, CANCEL or MYTICKETS checks the token is still live. A BOOK
+ * answers "OK\tBOOK\t<pnr>\t<seats left>\t<fare>", the fare being the
+ * total charged. With WAIT, one that finds no seats answers
+ * "OK\tBOOK\t<pnr>\tRAC|WL\t<place>\t<fare>" and is confirmed later, when a
+ * cancellation frees seats; TICKET rows end with the ticket's current status.
+ * A BOOK on a train whose PNR block is nearly full fails with pnrs_exhausted.
+ *
+ * Every command ends with one "OK\t<CMD>..." or "ERR\t<CMD>\t<reason>" line;
+ * LIST, MYTICKETS and SEARCH emit TRAIN / TICKET / JOURNEY rows before it,
+ * and STATS a QUEUE row (worker, depth) per worker and an ADMISSION row
+ * (admitted, batches, rate limited, shed). REPORT emits a REPORT row per
+ * train and a TOTAL row, each with the TicketAggregates fields in order
+ * (revenue in paise). METRICS emits the Prometheus text
+ * exposition, as served at /metrics. Over --serve, BOOK can also fail
+ * with rate_limited or busy. Blank lines and
+ * lines starting with '#' are ignored. Output is buffered and written in
+ * large blocks. Each runner is one session (login and travel date); the
+ * network server keeps one per connection, with no output stream, and
+ * collects the responses itself.
+ */
+class BatchRunner {
+public:
+    explicit BatchRunner(RailwayManager& railway, std::ostream* out = &std::cout)
+        : manager(railway), output(out) {}
+    std::size_t run(std::istream& in, std::ostream& out); // Returns commands executed
+    bool submit(const std::string& line);  // False for blank and comment lines
+    // As submit, but a BOOK goes through the admission stage; done runs once
+    // its response is in the output, perhaps later and on another thread
+    void submit(const std::string& line, std::function<void()> done);
+    void moveOutput(std::string& text) { output.moveTo(text); }
+
+private:
+    RailwayManager& manager;
+    std::string username; // Logged-in user for this session
+    std::string token;    // Its session token
+    RunDate date = currentDate();
+    OutputBuffer output;  // Responses, written out a chunk at a time
+    std::vector<std::string> args; // Reused between commands
+    std::function<void()> deferred; // Set while an asynchronous submit is being parsed
+
+    void execute(const std::vector<std::string>& args);
+    void book(const std::vector<std::string>& args);
+    void reportBooking(const BookingResult& result);
+    void list(const std::vector<std::string>& args);
+    void search(const std::vector<std::string>& args);
+    void report(const std::vector<std::string>& args);
+    static bool parseDay(const std::string& text, RunDate& date); // YYYY-MM-DD or +days from today
+    void error(const std::string& command, const std::string& reason);
+};
+
+std::size_t BatchRunner::run(std::istream& in, std::ostream& out) {
+    std::size_t executed = 0;
+    std::string line;
+    output.redirect(out);
+    while (std::getline(in, line)) {
+        if (submit(line)) ++executed;
     }
+    output.flush();
+    return executed;
+}
 
-    std::cout << "\n✅ Ticket with PNR " << pnr << " has been successfully cancelled." << std::endl;
+bool BatchRunner::submit(const std::string& line) {
+    args.clear();
+    std::istringstream tokens(line);
+    for (std::string token; tokens >> token;) args.push_back(token);
+    if (args.empty() || args[0][0] == '#') return false;
+    execute(args);
+    return true;
+}
+
+// Every command but an admitted BOOK finishes here, before done is called
+void BatchRunner::submit(const std::string& line, std::function<void()> done) {
+    deferred = std::move(done);
+    submit(line);
+    if (deferred) {
+        std::function<void()> finished = std::move(deferred);
+        deferred = nullptr;
+        finished();
+    }
+}
+
+void BatchRunner::execute(const std::vector<std::string>& args) {
+    std::string command = args[0];
+    std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+
+    if (command == "REGISTER") {
+        if (args.size() != 3) return error(command, "usage");
+        if (!manager.addUser(args[1], args[2])) return error(command, "user_exists");
+        output << "OK\tREGISTER\t" << args[1];
+        output.line();
+    } else if (command == "LOGIN") {
+        if (args.size() != 3) return error(command, "usage");
+        std::string issued = manager.openSession(args[1], args[2]);
+        if (issued.empty()) return error(command, "bad_credentials");
+        if (!token.empty()) manager.closeSession(token);
+        username = args[1];
+        token = issued;
+        output << "OK\tLOGIN\t" << username << '\t' << token;
+        output.line();
+    } else if (command == "RESUME") {
+        if (args.size() != 2) return error(command, "usage");
+        std::optional<std::string> user = manager.resumeSession(args[1]);
+        if (!user) return error(command, "no_session");
+        username = *user;
+        token = args[1];
+        output << "OK\tRESUME\t" << username;
+        output.line();
+    } else if (command == "LOGOUT") {
+        if (!token.empty()) manager.closeSession(token);
+        username.clear();
+        token.clear();
+        output << "OK\tLOGOUT";
+        output.line();
+    } else if (command == "LIST") {
+        list(args);
+    } else if (command == "SEARCH") {
+        search(args);
+    } else if (command == "DATE") {
+        RunDate travel;
+        if (args.size() != 2) return error(command, "usage");
+        if (!parseDay(args[1], travel)) return error(command, "bad_date");
+        if (!manager.bookable(travel)) return error(command, "outside_booking_window");
+        date = travel;
+        output << "OK\tDATE\t";
+        renderDate(output, date);
+        output.line();
+    } else if (command == "STATS") {
+        // OK STATS <workers> <executed> <stolen> <sharded>
+        RequestScheduler::Stats stats = manager.requestScheduler().stats();
+        for (std::size_t i = 0; i < stats.depth.size(); ++i) {
+            output << "QUEUE\t" << i << '\t' << stats.depth[i];
+            output.line();
+        }
+        BookingAdmission::Stats admission = manager.bookingAdmission().stats();
+        output << "ADMISSION\t" << admission.admitted << '\t' << admission.batches << '\t'
+               << admission.rateLimited << '\t' << admission.shed;
+        output.line();
+        output << "OK\tSTATS\t" << stats.workers << '\t' << stats.executed << '\t' << stats.stolen << '\t'
+               << stats.sharded;
+        output.line();
+    } else if (command == "REPORT") {
+        report(args);
+    } else if (command == "METRICS") {
+        manager.renderMetrics(output);
+        output << "OK\tMETRICS";
+        output.line();
+    } else if ((command == "BOOK" || command == "CANCEL" || command == "MYTICKETS") &&
+               (username.empty() || !manager.resumeSession(token))) {
+        // An expired or revoked session logs this runner out too
+        error(command, username.empty() ? "not_logged_in" : "session_expired");
+        username.clear();
+        token.clear();
+    } else if (command == "BOOK") {
+        book(args);
+    } else if (command == "CANCEL") {
+        if (args.size() != 2) return error(command, "usage");
+        Pnr pnr = std::strtoull(args[1].c_str(), nullptr, 10);
+        if (!manager.cancelBooking(pnr, username)) return error(command, "not_found");
+        output << "OK\tCANCEL\t" << args[1];
+        output.line();
+    } else if (command == "MYTICKETS") {
+        std::size_t count = 0;
+        manager.listUserTickets(username, [this, &count](const Ticket& ticket, const Train& train) {
+            output << "TICKET\t" << ticket.pnr << '\t' << ticket.trainNumber << '\t' << train.trainName() << '\t'
+                   << ticket.passengers.size() << '\t';
+            output.money(ticket.totalFare()) << '\t';
+            renderDate(output, ticket.travelDate);
+            output << '\t';
+            ticket.renderStatus(output, train);
+            output.line();
+            ++count;
+        });
+        output << "OK\tMYTICKETS\t" << count;
+        output.line();
+    } else {
+        error(command, "unknown_command");
+    }
+}
+
+// BOOK <train> <n> followed by exactly n passengers written as name:age:gender,
+// then optionally the boarding and alighting stations ('_' for a space), then
+// optionally WAIT to join the waiting list when seats are short and TATKAL
+// to book in the Tatkal quota, in either order
+void BatchRunner::book(const std::vector<std::string>& args) {
+    if (args.size() < 3) return error("BOOK", "usage");
+    int trainNum = std::atoi(args[1].c_str());
+    int count = std::atoi(args[2].c_str());
+    std::size_t passengerEnd = static_cast<std::size_t>(count) + 3;
+    bool wait = false;
+    Quota quota = Quota::General;
+    std::size_t argCount = args.size();
+    for (int flags = 0; flags < 2 && argCount > passengerEnd; ++flags) {
+        std::string last = args[argCount - 1];
+        std::transform(last.begin(), last.end(), last.begin(), ::toupper);
+        if (last == "WAIT" && !wait) wait = true;
+        else if (last == "TATKAL" && quota == Quota::General) quota = Quota::Tatkal;
+        else break;
+        --argCount;
+    }
+    if (count <= 0 || (argCount != passengerEnd && argCount != passengerEnd + 2)) return error("BOOK", "usage");
+    std::string from, to;
+    if (argCount > passengerEnd) {
+        from = args[passengerEnd];
+        to = args[passengerEnd + 1];
+        std::replace(from.begin(), from.end(), '_', ' ');
+        std::replace(to.begin(), to.end(), '_', ' ');
+    }
+
+    PassengerList passengers(count);
+    for (int i = 0; i < count; ++i) {
+        const std::string& spec = args[i + 3];
+        std::size_t first = spec.find(':');
+        std::size_t second = first == std::string::npos ? first : spec.find(':', first + 1);
+        if (second == std::string::npos || second + 1 >= spec.size()) return error("BOOK", "bad_passenger");
+        passengers[i].name = spec.substr(0, first);
+        passengers[i].age = std::atoi(spec.c_str() + first + 1);
+        passengers[i].gender = spec[second + 1];
+    }
+
+    if (deferred) {
+        std::function<void()> done = std::move(deferred);
+        deferred = nullptr;
+        BookingRequest request{trainNum, date, std::move(passengers), username, from, to, wait, quota};
+        manager.admitBooking(std::move(request), [this, done = std::move(done)](const BookingResult& result) {
+            reportBooking(result);
+            done();
+        });
+        return;
+    }
+    reportBooking(manager.placeBooking(trainNum, date, std::move(passengers), username, from, to, wait, quota));
+}
+
+void BatchRunner::reportBooking(const BookingResult& result) {
+    switch (result.status) {
+        case BookingStatus::Booked:
+            output << "OK\tBOOK\t" << result.pnr << '\t' << result.seatsLeft << '\t';
+            output.money(result.fare).line();
+            break;
+        case BookingStatus::Waitlisted:
+            // OK BOOK <pnr> RAC|WL <place> <fare>
+            output << "OK\tBOOK\t" << result.pnr << '\t' << (result.waitClass == WaitClass::Rac ? "RAC" : "WL")
+                   << '\t' << result.waitPlace << '\t';
+            output.money(result.fare).line();
+            break;
+        case BookingStatus::NoSuchTrain:
+            error("BOOK", "no_such_train");
+            break;
+        case BookingStatus::NotEnoughSeats:
+            error("BOOK", "not_enough_seats\t" + std::to_string(result.seatsLeft));
+            break;
+        case BookingStatus::InvalidRequest:
+            error("BOOK", "invalid_request");
+            break;
+        case BookingStatus::RateLimited:
+            error("BOOK", "rate_limited");
+            break;
+        case BookingStatus::Overloaded:
+            error("BOOK", "busy");
+            break;
+        case BookingStatus::PnrsExhausted:
+            error("BOOK", "pnrs_exhausted");
+            break;
+        case BookingStatus::RunCancelled:
+            error("BOOK", "run_cancelled");
+            break;
+    }
+}
+
+// LIST [number|fare|name] [limit] [fare=<min>-<max>] [seats=<n>]; walks the
+// cached sort view. seats= counts seats free end to end on the session date.
+void BatchRunner::list(const std::vector<std::string>& args) {
+    TrainSortKey key = TrainSortKey::Number;
+    if (args.size() > 1) {
+        std::string order = args[1];
+        std::transform(order.begin(), order.end(), order.begin(), ::tolower);
+        if (order == "fare") key = TrainSortKey::Fare;
+        else if (order == "name") key = TrainSortKey::Name;
+        else if (order != "number") return error("LIST", "bad_sort_key");
+    }
+    std::size_t limit = args.size() > 2 ? std::strtoul(args[2].c_str(), nullptr, 10) : 0;
+    TrainFilter filter;
+    filter.date = date;
+    for (std::size_t i = 3; i < args.size(); ++i) {
+        const std::string& condition = args[i];
+        if (condition.compare(0, 5, "fare=") == 0) {
+            double minRupees, maxRupees;
+            if (std::sscanf(condition.c_str() + 5, "%lf-%lf", &minRupees, &maxRupees) != 2) {
+                return error("LIST", "bad_filter");
+            }
+            filter.minFare = toPaise(minRupees);
+            filter.maxFare = toPaise(maxRupees);
+        } else if (condition.compare(0, 6, "seats=") == 0) {
+            filter.minSeats = std::atoi(condition.c_str() + 6);
+        } else {
+            return error("LIST", "bad_filter");
+        }
+    }
+
+    std::size_t count = 0;
+    manager.listTrains(key, limit, filter, [this, &count](const Train& train) {
+        output << "TRAIN\t" << train.trainNumber << '\t' << train.trainName() << '\t'
+               << train.source() << '\t' << train.destination() << '\t';
+        output.money(train.fare.load()) << '\t' << train.seatsFree(date, 0, train.segments()) << '\t'
+                                 << train.totalSeats.load();
+        output.line();
+        ++count;
+    });
+    output << "OK\tLIST\t" << count;
+    output.line();
+}
+
+// SEARCH <from> <to> [maxChanges]; one JOURNEY row per route, legs as train:from:to
+void BatchRunner::search(const std::vector<std::string>& args) {
+    if (args.size() < 3 || args.size() > 4) return error("SEARCH", "usage");
+    std::string from = args[1], to = args[2];
+    std::replace(from.begin(), from.end(), '_', ' ');
+    std::replace(to.begin(), to.end(), '_', ' ');
+    int maxTransfers = args.size() > 3 ? std::atoi(args[3].c_str()) : 1;
+
+    std::vector<std::vector<JourneyLeg>> journeys = manager.findJourneys(from, to, maxTransfers, 20);
+    for (const std::vector<JourneyLeg>& journey : journeys) {
+        output << "JOURNEY\t" << journey.size() - 1;
+        for (const JourneyLeg& leg : journey) {
+            output << '\t' << leg.trainNumber << ':' << leg.from << ':' << leg.to;
+        }
+        output.line();
+    }
+    output << "OK\tSEARCH\t" << journeys.size();
+    output.line();
+}
+
+bool BatchRunner::parseDay(const std::string& text, RunDate& date) {
+    if (text[0] != '+') return parseDate(text, date);
+    date = currentDate() + std::atoi(text.c_str() + 1);
+    return true;
+}
+
+// REPORT [train] reads the running totals; with a date range it runs a scan
+void BatchRunner::report(const std::vector<std::string>& args) {
+    if (args.size() > 4 || args.size() == 3) return error("REPORT", "usage");
+    ReportQuery query;
+    if (args.size() >= 2) query.trainNumber = std::atoi(args[1].c_str());
+    if (args.size() == 4 && (!parseDay(args[2], query.firstDate) || !parseDay(args[3], query.lastDate))) {
+        return error("REPORT", "bad_date");
+    }
+    TicketAggregates::Values overall;
+    std::vector<ReportRow> rows;
+    if (args.size() == 4) {
+        rows = manager.runReport(query, overall);
+    } else {
+        rows = manager.dashboard(overall);
+        if (query.trainNumber != 0) {
+            rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                      [&query](const ReportRow& row) { return row.trainNumber != query.trainNumber; }),
+                       rows.end());
+            overall = rows.empty() ? TicketAggregates::Values{} : rows[0].totals;
+        }
+    }
+    auto fields = [this](const TicketAggregates::Values& values) {
+        for (std::int64_t value : values) output << '\t' << value;
+        output.line();
+    };
+    for (const ReportRow& row : rows) {
+        output << "REPORT\t" << row.trainNumber;
+        fields(row.totals);
+    }
+    output << "TOTAL";
+    fields(overall);
+    output << "OK\tREPORT\t" << rows.size();
+    output.line();
+}
+
+void BatchRunner::error(const std::string& command, const std::string& reason) {
+    output << "ERR\t" << command << '\t' << reason;
+    output.line();
+}
+
+// =====================================================================
+// NETWORK SERVICE
+// =====================================================================
+
+#if defined(__linux__)
+
+/**
+ * @class NetworkServer
+ * @brief Multi-client TCP front end speaking the batch protocol.
+ * Each event loop thread owns an epoll set and its own SO_REUSEPORT
+ * listening socket, so the kernel spreads new connections across loops.
+ * Loops only move bytes: every connection is a BatchRunner session of its
+ * own, replacing the console's single currentUser, and its requests run
+ * on the manager's RequestScheduler. A session runs one request at a time,
+ * so responses keep their order. Bookings pass through the BookingAdmission
+ * stage, which batches them per train on a fixed worker; everything else
+ * goes to whichever worker is free. Requests
+ * may be pipelined. A client that stops reading has its input paused once
+ * kMaxPendingBytes of responses or kMaxQueuedRequests requests are waiting.
+ * A connection whose first line is an HTTP GET is a metrics scrape instead:
+ * GET /metrics is answered with the Prometheus exposition and the
+ * connection is closed, so scrapers need no port of their own.
+ */
+class NetworkServer {
+public:
+    static constexpr std::size_t kMaxLineBytes = 1 << 16;
+    static constexpr std::size_t kMaxPendingBytes = 4 << 20;
+    static constexpr std::size_t kMaxQueuedRequests = 4096;
+
+    NetworkServer(RailwayManager& railway, int listenPort, int eventLoops)
+        : manager(railway), port(listenPort), loops(std::max(1, eventLoops)) {}
+    int serve(); // Runs until SIGINT or SIGTERM; returns the exit status
+
+private:
+    struct EventLoop;
+
+    struct Connection {
+        Connection(RailwayManager& railway, EventLoop& owner, int socket)
+            : session(railway, nullptr), loop(owner), fd(socket) {}
+        BatchRunner session;  // Used only by the task running this connection's request
+        EventLoop& loop;
+        int fd;
+        // Owned by the loop thread
+        std::string input;    // Bytes after the last complete line
+        std::string output;   // Responses not yet accepted by the socket
+        std::size_t sent = 0;
+        bool closing = false; // The client has finished sending
+        bool open = true;
+        bool started = false; // Its first line has arrived
+        bool http = false;    // That line was an HTTP GET
+        // Shared between the loop and the scheduler
+        std::mutex mutex;
+        std::deque<std::string> requests; // Received, not yet started
+        std::string responses;            // Finished, not yet collected by the loop
+        bool running = false;             // A scheduler task holds the session
+        bool announced = false;           // Already on the loop's completed list
+    };
+
+    struct EventLoop {
+        int epollFd = -1;
+        int listener = -1;
+        int notifyFd = -1; // eventfd, bumped when requests complete
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Connection>> completed;
+    };
+
+    RailwayManager& manager;
+    int port;
+    int loops;
+    int stopFd = -1; // eventfd that tells every loop to stop
+
+    int openListener(); // Returns the socket, or -1 after printing why
+    void eventLoop(EventLoop& loop);
+    void dispatch(const std::shared_ptr<Connection>& connection, std::string request);
+    void finish(const std::shared_ptr<Connection>& connection);
+    void scrape(const std::shared_ptr<Connection>& connection, std::string path); // Answers one HTTP GET
+    void collect(EventLoop& loop, std::unordered_map<int, std::shared_ptr<Connection>>& connections);
+    // Both return false once the connection should be closed
+    bool receive(const std::shared_ptr<Connection>& connection);
+    bool transmit(Connection& connection);
+};
+
+int NetworkServer::serve() {
+    // Signals are taken synchronously by this thread; no other thread sees them
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::vector<std::unique_ptr<EventLoop>> eventLoops;
+    for (int i = 0; i < loops; ++i) {
+        auto loop = std::make_unique<EventLoop>();
+        loop->listener = openListener();
+        if (loop->listener < 0) {
+            for (auto& opened : eventLoops) close(opened->listener);
+            close(stopFd);
+            return 1;
+        }
+        loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        for (int fd : {loop->listener, loop->notifyFd, stopFd}) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, fd, &event);
+        }
+        eventLoops.push_back(std::move(loop));
+    }
+    std::cerr << "Listening on port " << port << " with " << loops << " event loop"
+              << (loops == 1 ? "" : "s") << " and " << manager.requestScheduler().workers()
+              << " workers" << std::endl;
+
+    std::vector<std::thread> threads;
+    for (auto& loop : eventLoops) threads.emplace_back(&NetworkServer::eventLoop, this, std::ref(*loop));
+    int signal = 0;
+    sigwait(&stopSignals, &signal);
+    std::uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0) std::perror("eventfd");
+    for (std::thread& thread : threads) thread.join();
+    // Requests already started finish before the loops they report to go away
+    manager.requestScheduler().wait();
+    for (auto& loop : eventLoops) {
+        close(loop->notifyFd);
+        close(loop->epollFd);
+    }
+    close(stopFd);
+    std::cerr << "Server stopped." << std::endl;
+    return 0;
+}
+
+// Port 0 binds an ephemeral port on the first listener; the others share it
+int NetworkServer::openListener() {
+    int fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::perror("socket");
+        return -1;
+    }
+    int on = 1, off = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)); // IPv4 clients too
+    sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(static_cast<std::uint16_t>(port));
+    socklen_t length = sizeof(address);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), length) < 0 || listen(fd, SOMAXCONN) < 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+        std::cerr << "❌ Cannot listen on port " << port << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    port = ntohs(address.sin6_port);
+    return fd;
+}
+
+void NetworkServer::eventLoop(EventLoop& loop) {
+    std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    std::array<epoll_event, 64> ready;
+    bool running = true;
+    while (running) {
+        int count = epoll_wait(loop.epollFd, ready.data(), static_cast<int>(ready.size()), -1);
+        if (count < 0 && errno != EINTR) break;
+        for (int i = 0; i < count; ++i) {
+            int fd = ready[i].data.fd;
+            if (fd == stopFd) {
+                running = false; // The eventfd stays readable, so every loop sees it
+            } else if (fd == loop.notifyFd) {
+                collect(loop, connections);
+            } else if (fd == loop.listener) {
+                for (int client; (client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0;) {
+                    int on = 1;
+                    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                    epoll_event event{};
+                    event.events = EPOLLIN | EPOLLRDHUP;
+                    event.data.fd = client;
+                    epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, client, &event);
+                    connections[client] = std::make_shared<Connection>(manager, loop, client);
+                }
+            } else {
+                auto found = connections.find(fd);
+                if (found == connections.end()) continue;
+                std::shared_ptr<Connection> connection = found->second;
+                bool open = !(ready[i].events & EPOLLERR);
+                if (open && (ready[i].events & EPOLLOUT)) open = transmit(*connection);
+                if (open && (ready[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) open = receive(connection);
+                if (!open) {
+                    connection->open = false;
+                    std::lock_guard<std::mutex> lock(connection->mutex);
+                    connection->requests.clear(); // Nobody is left to answer
+                    close(fd); // Also removes it from the epoll set
+                    connections.erase(found);
+                }
+            }
+        }
+    }
+    for (auto& entry : connections) {
+        entry.second->open = false;
+        std::lock_guard<std::mutex> lock(entry.second->mutex);
+        entry.second->requests.clear();
+        close(entry.first);
+    }
+    close(loop.listener);
+}
+
+// Requests run on whichever worker is free. A BOOK is handed on to the
+// admission stage, and the session carries on from wherever it is answered.
+void NetworkServer::dispatch(const std::shared_ptr<Connection>& connection, std::string request) {
+    manager.requestScheduler().submit([this, connection, request = std::move(request)] {
+        connection->session.submit(request, [this, connection] { finish(connection); });
+    });
+}
+
+// Hands the response to the loop and starts the connection's next request, if any
+void NetworkServer::finish(const std::shared_ptr<Connection>& connection) {
+    std::string next;
+    bool announce;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->session.moveOutput(connection->responses);
+        connection->running = !connection->requests.empty();
+        if (connection->running) {
+            next = std::move(connection->requests.front());
+            connection->requests.pop_front();
+        }
+        announce = !connection->announced;
+        connection->announced = true;
+    }
+    if (announce) {
+        EventLoop& loop = connection->loop;
+        {
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            loop.completed.push_back(connection);
+        }
+        std::uint64_t one = 1;
+        if (write(loop.notifyFd, &one, sizeof(one)) < 0) std::perror("eventfd");
+    }
+    if (!next.empty()) dispatch(connection, std::move(next));
+}
+
+// Renders on a worker, as any request would, and closes after the reply
+void NetworkServer::scrape(const std::shared_ptr<Connection>& connection, std::string path) {
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->running = true;
+    }
+    manager.requestScheduler().submit([this, connection, path = std::move(path)] {
+        std::string body;
+        const char* status = "200 OK";
+        if (path == "/metrics") {
+            OutputBuffer exposition(nullptr);
+            manager.renderMetrics(exposition);
+            exposition.moveTo(body);
+        } else {
+            status = "404 Not Found";
+            body = "Not found; metrics are at /metrics\n";
+        }
+        OutputBuffer reply(nullptr);
+        reply << "HTTP/1.1 " << status << "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+              << "Content-Length: " << body.size() << "\r\nConnection: close\r\n\r\n" << body;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            reply.moveTo(connection->responses);
+        }
+        finish(connection);
+    });
+}
+
+// Moves finished responses onto their sockets
+void NetworkServer::collect(EventLoop& loop, std::unordered_map<int, std::shared_ptr<Connection>>& connections) {
+    std::uint64_t count;
+    if (read(loop.notifyFd, &count, sizeof(count)) < 0 && errno != EAGAIN) std::perror("eventfd");
+    std::vector<std::shared_ptr<Connection>> completed;
+    {
+        std::lock_guard<std::mutex> lock(loop.mutex);
+        completed.swap(loop.completed);
+    }
+    for (const std::shared_ptr<Connection>& connection : completed) {
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->announced = false;
+            connection->output += connection->responses;
+            connection->responses.clear();
+        }
+        if (connection->open && !transmit(*connection)) {
+            connection->open = false;
+            close(connection->fd);
+            connections.erase(connection->fd);
+        }
+    }
+}
+
+// Queues every complete line received so far; the first one starts the session
+bool NetworkServer::receive(const std::shared_ptr<Connection>& connection) {
+    Connection& state = *connection;
+    char chunk[16384];
+    while (!state.closing && state.output.size() - state.sent < kMaxPendingBytes) {
+        ssize_t received = recv(state.fd, chunk, sizeof(chunk), 0);
+        if (received == 0) {
+            state.closing = true;
+            break;
+        }
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            break;
+        }
+        state.input.append(chunk, static_cast<std::size_t>(received));
+        if (!state.started && state.input.find('\n') != std::string::npos) {
+            state.started = true;
+            state.http = state.input.compare(0, 4, "GET ") == 0;
+        }
+        if (state.http) {
+            // The request line is all that matters, once the headers have ended
+            if (state.input.find("\n\r\n") != std::string::npos || state.input.find("\n\n") != std::string::npos) {
+                std::size_t end = state.input.find_first_of(" \r\n", 4);
+                scrape(connection, state.input.substr(4, end - 4));
+                state.closing = true;
+                break;
+            }
+            if (state.input.size() > kMaxLineBytes) return false;
+            continue;
+        }
+
+        std::string first;
+        std::size_t start = 0;
+        bool backlog;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            for (std::size_t end; (end = state.input.find('\n', start)) != std::string::npos; start = end + 1) {
+                std::size_t length = end - start;
+                if (length > 0 && state.input[end - 1] == '\r') --length; // Telnet-style line ends
+                if (length == 0) continue;
+                std::string request = state.input.substr(start, length);
+                if (!state.running) {
+                    state.running = true;
+                    first = std::move(request);
+                } else {
+                    state.requests.push_back(std::move(request));
+                }
+            }
+            backlog = state.requests.size() >= kMaxQueuedRequests;
+        }
+        state.input.erase(0, start);
+        if (!first.empty()) dispatch(connection, std::move(first));
+        if (backlog) break;
+        if (state.input.size() > kMaxLineBytes) {
+            state.output += "ERR\tREQUEST\tline_too_long\n";
+            state.closing = true;
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.requests.clear();
+        }
+    }
+    return transmit(state);
+}
+
+// Sends queued responses and updates which events the loop waits for. A
+// half-closed client still receives every response before the socket closes.
+bool NetworkServer::transmit(Connection& connection) {
+    while (connection.sent < connection.output.size()) {
+        ssize_t written = send(connection.fd, connection.output.data() + connection.sent,
+                               connection.output.size() - connection.sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            break;
+        }
+        connection.sent += static_cast<std::size_t>(written);
+    }
+    bool drained = connection.sent == connection.output.size();
+    if (drained) {
+        connection.output.clear();
+        connection.sent = 0;
+    }
+    bool backlog;
+    {
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        if (drained && connection.closing && !connection.running && connection.responses.empty()) return false;
+        backlog = connection.requests.size() >= kMaxQueuedRequests;
+    }
+    bool reading = !connection.closing && !backlog && connection.output.size() - connection.sent < kMaxPendingBytes;
+    epoll_event event{};
+    event.events = 0;
+    if (reading) event.events |= EPOLLIN | EPOLLRDHUP;
+    if (!drained) event.events |= EPOLLOUT;
+    event.data.fd = connection.fd;
+    epoll_ctl(connection.loop.epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    return true;
+}
+
+#endif // __linux__
+
+// =====================================================================
+// BENCHMARKS
+// =====================================================================
+
+// Scale of the state a benchmark run builds before measuring
+struct BenchConfig {
+    std::size_t trains = 10000;
+    std::size_t tickets = 1000000;
+    std::size_t users = 100000;
+    std::size_t ops = 200000; // Operations per measured scenario
+    int threads = 4;          // For the contention scenarios, and event loops for --serve
+};
+
+/**
+ * @class RailwayBenchmark
+ * @brief Measures the booking-core hot paths on an in-memory RailwayManager
+ * populated at realistic scale. Every scenario reports throughput and
+ * p50/p99 latency; the contention scenarios run across several threads.
+ */
+class RailwayBenchmark {
+public:
+    explicit RailwayBenchmark(const BenchConfig& benchConfig) : config(benchConfig), manager("") {}
+    void run(std::ostream& out);
+
+private:
+    BenchConfig config;
+    RailwayManager manager;
+    std::vector<std::string> usernames;
+    std::vector<std::pair<Pnr, std::uint32_t>> booked; // PNR and index of its user
+    RunDate date = currentDate();                      // Every booking is for today's runs
+
+    static constexpr int kFirstTrain = 100000;
+    static constexpr int kHotTrain = 99999; // Single train every contention thread hits
+
+    // op(rng) runs one timed operation; total is split across threads
+    template <typename Op>
+    void measure(std::ostream& out, const std::string& name, std::size_t total, int threads, Op op);
+    void populate(std::ostream& out);
+};
+
+template <typename Op>
+void RailwayBenchmark::measure(std::ostream& out, const std::string& name, std::size_t total,
+                               int threads, Op op) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::vector<std::uint64_t>> latencies(threads);
+    std::vector<std::thread> workers;
+    auto start = Clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 rng(0x5EED + t);
+            std::size_t count = total / threads + (static_cast<std::size_t>(t) < total % threads ? 1 : 0);
+            std::vector<std::uint64_t>& mine = latencies[t];
+            mine.reserve(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                auto begin = Clock::now();
+                op(rng);
+                mine.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<std::uint64_t> all;
+    all.reserve(total);
+    for (const auto& mine : latencies) all.insert(all.end(), mine.begin(), mine.end());
+    // A scenario left nothing to run on still gets its row
+    out << std::left << std::setw(34) << name << std::right << std::setw(10) << all.size();
+    if (all.empty()) {
+        out << "    (nothing to measure)" << std::endl;
+        return;
+    }
+    std::sort(all.begin(), all.end());
+    out << std::setw(14) << std::fixed << std::setprecision(0) << all.size() / seconds
+        << std::setw(12) << all[all.size() / 2]
+        << std::setw(12) << all[std::min(all.size() - 1, all.size() * 99 / 100)] << std::endl;
+}
+
+// Trains, users and tickets at the configured scale; timing the ticket load
+// doubles as the single-threaded booking benchmark
+void RailwayBenchmark::populate(std::ostream& out) {
+    int seatsPerTrain = static_cast<int>(std::max<std::size_t>(200, 3 * config.tickets / std::max<std::size_t>(1, config.trains)));
+    for (std::size_t i = 0; i < config.trains; ++i) {
+        manager.addTrain(Train(kFirstTrain + static_cast<int>(i), "Express " + std::to_string(i),
+                               "Station " + std::to_string(i % 700), "Station " + std::to_string((i * 31 + 7) % 700),
+                               toPaise(300.0 + static_cast<double>(i * 37 % 4000)), seatsPerTrain));
+    }
+    // Sized so the contention run never sells out; seats cost a bit each in the inventory
+    int hotSeats = static_cast<int>(std::min<std::size_t>(2 * config.ops + 1000, std::numeric_limits<int>::max() / 2));
+    manager.addTrain(Train(kHotTrain, "Rajdhani Express", "Mumbai", "New Delhi", toPaise(2870.00), hotSeats));
+
+    // Registering at full KDF cost would take minutes; the login rows measure it instead
+    manager.setPasswordCost(1);
+    usernames.reserve(config.users);
+    for (std::size_t i = 0; i < config.users; ++i) {
+        usernames.push_back("user" + std::to_string(i));
+        manager.addUser(usernames.back(), "password");
+    }
+
+    booked.reserve(config.tickets);
+    std::mutex bookedMutex;
+    measure(out, "book (populate, 1 thread)", config.tickets, 1, [&](std::mt19937_64& rng) {
+        std::uint32_t user = static_cast<std::uint32_t>(rng() % usernames.size());
+        int train = kFirstTrain + static_cast<int>(rng() % config.trains);
+        BookingResult result = manager.placeBooking(train, date, {Passenger{"Passenger", 30, 'M'}}, usernames[user]);
+        std::lock_guard<std::mutex> lock(bookedMutex);
+        booked.emplace_back(result.pnr, user);
+    });
+}
+
+void RailwayBenchmark::run(std::ostream& out) {
+    out << "Scale: " << config.trains << " trains, " << config.tickets << " tickets, "
+        << config.users << " users; " << config.ops << " ops per scenario\n\n";
+    out << std::left << std::setw(34) << "operation" << std::right << std::setw(10) << "ops"
+        << std::setw(14) << "ops/sec" << std::setw(12) << "p50 (ns)" << std::setw(12) << "p99 (ns)" << std::endl;
+    out << std::string(82, '-') << std::endl;
+
+    populate(out);
+    const std::size_t ops = config.ops;
+    const int threads = config.threads;
+    std::size_t sink = 0; // Keeps listing callbacks from being optimised away
+
+    PnrAllocator allocator(42);
+    measure(out, "generatePNR", ops, 1, [&](std::mt19937_64& rng) {
+        sink += allocator.next(rng() % PnrAllocator::kShards) & 1;
+    });
+    // A family of six over any leg of a five-segment route, either quota, at any occupancy
+    FareTable fares;
+    fares.build(toPaise(2870.00), 5);
+    PassengerList family{Passenger{"Father", 42, 'M'}, Passenger{"Mother", 39, 'F'}, Passenger{"Son", 14, 'M'},
+                         Passenger{"Daughter", 8, 'F'}, Passenger{"Grandfather", 71, 'M'},
+                         Passenger{"Grandmother", 66, 'F'}};
+    measure(out, "price 6 passengers (surge)", ops, 1, [&](std::mt19937_64& rng) {
+        std::uint64_t draw = rng();
+        Quota quota = draw & 1 ? Quota::Tatkal : Quota::General;
+        int distance = 1 + static_cast<int>((draw >> 8) % 5);
+        FareEngine::price(fares, quota, distance, static_cast<int>((draw >> 16) % 11), family);
+        sink += static_cast<std::size_t>(family[5].fare) & 1;
+    });
+    measure(out, "train lookup", ops, 1, [&](std::mt19937_64& rng) {
+        sink += manager.seatsLeft(kFirstTrain + static_cast<int>(rng() % config.trains), date) & 1;
+    });
+    measure(out, "name lookup (interned username)", ops, 1, [&](std::mt19937_64& rng) {
+        sink += NamePool::instance().find(usernames[rng() % usernames.size()]) & 1;
+    });
+    measure(out, "viewMyTickets", ops, 1, [&](std::mt19937_64& rng) {
+        manager.listUserTickets(usernames[rng() % usernames.size()],
+                                [&sink](const Ticket& ticket, const Train&) { sink += ticket.passengers.size(); });
+    });
+    measure(out, "viewAndSortTrains (top 50 by fare)", ops / 10, 1, [&](std::mt19937_64&) {
+        manager.listTrains(TrainSortKey::Fare, 50, [&sink](const Train& train) { sink += train.trainNumber & 1; });
+    });
+    measure(out, "viewAndSortTrains (all by name)", std::max<std::size_t>(1, ops / 1000), 1, [&](std::mt19937_64&) {
+        manager.listTrains(TrainSortKey::Name, 0, [&sink](const Train& train) { sink += train.trainNumber & 1; });
+    });
+    measure(out, "filter by fare range (all by number)", std::max<std::size_t>(1, ops / 100), 1, [&](std::mt19937_64& rng) {
+        TrainFilter filter;
+        filter.minFare = toPaise(300.0 + static_cast<double>(rng() % 3000));
+        filter.maxFare = filter.minFare + toPaise(500.0);
+        manager.listTrains(TrainSortKey::Number, 0, filter, [&sink](const Train& train) { sink += train.trainNumber & 1; });
+    });
+
+    // A full-cost login, then the token check every later request pays instead
+    manager.setPasswordCost(PasswordHasher::kDefaultIterations);
+    manager.addUser("bench-login", "password");
+    std::vector<std::string> tokens;
+    measure(out, "login (KDF)", std::max<std::size_t>(1, ops / 10000), 1, [&](std::mt19937_64&) {
+        tokens.push_back(manager.openSession("bench-login", "password"));
+    });
+    measure(out, "session resume", ops, 1, [&](std::mt19937_64& rng) {
+        sink += manager.resumeSession(tokens[rng() % tokens.size()]).has_value();
+    });
+
+    // Cancel a random sample of the populated tickets
+    std::mt19937_64 shuffler(7);
+    std::shuffle(booked.begin(), booked.end(), shuffler);
+    std::atomic<std::size_t> nextCancel{0};
+    std::size_t cancels = std::min(ops, booked.size() / 2); // The rest are for the cancel + lookup mix
+    measure(out, "cancelTicket", cancels, 1, [&](std::mt19937_64&) {
+        const auto& entry = booked[nextCancel++];
+        manager.cancelBooking(entry.first, usernames[entry.second]);
+    });
+
+    // Contention: many threads selling seats on one popular train, then spread out
+    std::string label = " (" + std::to_string(threads) + " threads)";
+    measure(out, "book, one hot train" + label, ops, threads, [&](std::mt19937_64& rng) {
+        manager.placeBooking(kHotTrain, date, {Passenger{"Passenger", 30, 'F'}}, usernames[rng() % usernames.size()]);
+    });
+    measure(out, "book, random trains" + label, ops, threads, [&](std::mt19937_64& rng) {
+        manager.placeBooking(kFirstTrain + static_cast<int>(rng() % config.trains), date,
+                             {Passenger{"Passenger", 30, 'F'}}, usernames[rng() % usernames.size()]);
+    });
+    // The same traffic handed to the request scheduler, each booking on its train's worker
+    RequestScheduler& scheduler = manager.requestScheduler();
+    measure(out, "book via scheduler" + label, ops, threads, [&](std::mt19937_64& rng) {
+        int train = kFirstTrain + static_cast<int>(rng() % config.trains);
+        const std::string& user = usernames[rng() % usernames.size()];
+        std::promise<void> done;
+        scheduler.submitTo(BookingAdmission::lane(train), [&] {
+            manager.placeBooking(train, date, {Passenger{"Passenger", 30, 'F'}}, user);
+            done.set_value();
+        });
+        done.get_future().wait();
+    });
+    // Bursts on the popular train through the admission stage, unthrottled, so
+    // each burst's bookings can share one allocation pass and one fsync wait
+    constexpr std::size_t kBurst = 16;
+    manager.bookingAdmission().setLimits(BookingAdmission::Limits{0, 0});
+    measure(out, "book burst via admission" + label, std::max<std::size_t>(1, ops / kBurst), threads,
+            [&](std::mt19937_64& rng) {
+                std::atomic<std::size_t> pending{kBurst};
+                std::promise<void> done;
+                for (std::size_t i = 0; i < kBurst; ++i) {
+                    BookingRequest request{kHotTrain, date, {Passenger{"Passenger", 30, 'F'}},
+                                           usernames[rng() % usernames.size()], "", ""};
+                    manager.admitBooking(std::move(request), [&](const BookingResult&) {
+                        if (--pending == 0) done.set_value();
+                    });
+                }
+                done.get_future().wait();
+            });
+    std::atomic<std::size_t> nextMixed{cancels};
+    std::atomic<std::size_t> mixedSink{0}; // Shared by the threads, so folded into sink afterwards
+    measure(out, "cancel + lookup mix" + label, std::min(ops, booked.size() - cancels), threads,
+            [&](std::mt19937_64& rng) {
+                const auto& entry = booked[nextMixed++];
+                manager.cancelBooking(entry.first, usernames[entry.second]);
+                int left = manager.seatsLeft(kFirstTrain + static_cast<int>(rng() % config.trains), date);
+                mixedSink.fetch_add(left & 1, std::memory_order_relaxed);
+            });
+    sink += mixedSink.load();
+
+    // Reports: the running totals, then full parallel scans over every ticket
+    TicketAggregates::Values overall;
+    measure(out, "report dashboard (live totals)", std::max<std::size_t>(1, ops / 1000), 1, [&](std::mt19937_64&) {
+        sink += manager.dashboard(overall).size();
+    });
+    measure(out, "report scan (date range)", 5, 1, [&](std::mt19937_64&) {
+        ReportQuery query;
+        query.firstDate = date;
+        query.lastDate = date + 30;
+        sink += manager.runReport(query, overall).size();
+    });
+    measure(out, "CSV export (all tickets)", 1, 1, [&](std::mt19937_64&) {
+        std::ostream discard(nullptr); // Rendered, then dropped
+        sink += manager.exportTickets(ReportQuery(), discard);
+    });
+    // Bookings beside an export that loops over every ticket: it reads
+    // snapshots, so bookings should cost what they do with no reader
+    std::atomic<bool> exporting{true};
+    std::thread exporter([&] {
+        while (exporting) {
+            std::ostream discard(nullptr);
+            manager.exportTickets(ReportQuery(), discard);
+        }
+    });
+    measure(out, "book during CSV export" + label, ops, threads, [&](std::mt19937_64& rng) {
+        manager.placeBooking(kFirstTrain + static_cast<int>(rng() % config.trains), date,
+                             {Passenger{"Passenger", 30, 'F'}}, usernames[rng() % usernames.size()]);
+    });
+    exporting = false;
+    exporter.join();
+
+    // Train-level operations on one train whose runs hold up to 100k tickets
+    constexpr int kBulkTrain = 99998;
+    constexpr RunDate kBulkRuns = 100;
+    std::size_t bulkTickets = std::min<std::size_t>(config.tickets, 100000);
+    int bulkSeats = static_cast<int>(std::max<std::size_t>(10, (bulkTickets + kBulkRuns - 1) / kBulkRuns));
+    RunDate today = currentDate();
+    manager.addTrain(Train(kBulkTrain, "Shatabdi Express", "New Delhi", "Bhopal", toPaise(1450.00), bulkSeats));
+    for (std::size_t i = 0; i < bulkTickets; ++i) {
+        manager.placeBooking(kBulkTrain, today + 1 + static_cast<RunDate>(i % kBulkRuns),
+                             {Passenger{"Passenger", 30, 'F'}}, usernames[i % usernames.size()]);
+    }
+    std::string tickets = " (" + std::to_string(bulkTickets) + " tickets)";
+    TrainChangeResult changed;
+    measure(out, "cut capacity 10%" + tickets, 1, 1, [&](std::mt19937_64&) {
+        manager.resizeTrain(kBulkTrain, bulkSeats - bulkSeats / 10, changed);
+    });
+    sink += changed.cancelled;
+    measure(out, "cancel train runs" + tickets, 1, 1, [&](std::mt19937_64&) {
+        manager.cancelTrainRuns(kBulkTrain, today, today + kBulkRuns, changed);
+    });
+    sink += changed.cancelled;
+
+    out << "\n(checksum " << sink << ")" << std::endl;
 }
 
 // =====================================================================
 // MAIN FUNCTION
 // =====================================================================
-int main() {
-    RailwayManager app;
-    app.run();
+
+/*
+ * Usage: railway [--data DIR | --in-memory] [--diff-redraw] [--kdf-iterations N] [--batch [FILE]]
+ *        railway [--data DIR | --in-memory] --serve PORT [--threads N] [--workers N]
+ *                [--user-rate N] [--train-rate N]
+ *        railway --bench [--trains N] [--tickets N] [--users N] [--ops N] [--threads N]
+ * Without --batch the interactive menus run. With it, commands are read
+ * from FILE (or stdin) and a throughput summary is printed to stderr.
+ * --serve answers the same commands over TCP until SIGINT or SIGTERM;
+ * --workers sizes the request scheduler (default: one per core), and
+ * --user-rate and --train-rate cap the bookings per second the server
+ * admits for one user and for one train (0 for no cap).
+ * --kdf-iterations sets the password hashing cost for new accounts.
+ * --bench measures the booking core in memory and prints a report.
+ */
+int main(int argc, char* argv[]) {
+    std::string dataDir = ".";
+    bool batch = false;
+    bool bench = false;
+    bool surge = false;
+    int servePort = -1;
+    unsigned workers = std::thread::hardware_concurrency();
+    std::uint32_t kdfIterations = PasswordHasher::kDefaultIterations;
+    BookingAdmission::Limits admissionLimits;
+    BenchConfig benchConfig;
+    std::string batchFile;
+    std::string trainImport, userImport;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--bench") {
+            bench = true;
+        } else if (hasValue && (arg == "--trains" || arg == "--tickets" || arg == "--users" || arg == "--ops")) {
+            std::size_t value = std::strtoull(argv[++i], nullptr, 10);
+            if (arg == "--trains") benchConfig.trains = std::max<std::size_t>(1, value);
+            if (arg == "--tickets") benchConfig.tickets = value;
+            if (arg == "--users") benchConfig.users = std::max<std::size_t>(1, value);
+            if (arg == "--ops") benchConfig.ops = value;
+        } else if (arg == "--threads" && hasValue) {
+            benchConfig.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--data" && hasValue) {
+            dataDir = argv[++i];
+        } else if (arg == "--in-memory") {
+            dataDir.clear();
+        } else if (arg == "--diff-redraw") {
+            Terminal::instance().setDifferential(true);
+        } else if (arg == "--surge") {
+            surge = true;
+        } else if (arg == "--import-trains" && hasValue) {
+            trainImport = argv[++i];
+        } else if (arg == "--import-users" && hasValue) {
+            userImport = argv[++i];
+        } else if (arg == "--serve" && hasValue) {
+            servePort = std::atoi(argv[++i]);
+        } else if (arg == "--kdf-iterations" && hasValue) {
+            kdfIterations = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if ((arg == "--user-rate" || arg == "--train-rate") && hasValue) {
+            double rate = std::max(0.0, std::atof(argv[++i]));
+            (arg == "--user-rate" ? admissionLimits.userRate : admissionLimits.trainRate) = rate;
+        } else if (arg == "--workers" && hasValue) {
+            workers = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--batch") {
+            batch = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') batchFile = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--data DIR | --in-memory] [--diff-redraw] [--kdf-iterations N] [--surge]"
+                      << " [--import-trains CSV] [--import-users CSV] [--batch [FILE]]\n"
+                      << "       " << argv[0] << " [--data DIR | --in-memory] --serve PORT [--threads N] [--workers N]"
+                      << " [--user-rate N] [--train-rate N] [--surge]\n"
+                      << "       " << argv[0] << " --bench [--trains N] [--tickets N] [--users N]"
+                      << " [--ops N] [--threads N]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (bench) {
+        RailwayBenchmark(benchConfig).run(std::cout);
+        return 0;
+    }
+
+    RailwayManager app(dataDir, workers);
+    app.setPasswordCost(kdfIterations);
+    app.setSurgePricing(surge);
+    // Imports run before any front end starts; on their own, they are all the run does
+    for (int kind = 0; kind < 2; ++kind) {
+        const std::string& path = kind == 0 ? trainImport : userImport;
+        if (path.empty()) continue;
+        std::ifstream csv(path, std::ios::binary);
+        if (!csv) {
+            std::cerr << "❌ Cannot open " << path << std::endl;
+            return 1;
+        }
+        ImportResult result = kind == 0 ? app.importTrains(csv) : app.importUsers(csv);
+        OutputBuffer report(std::cerr);
+        result.render(report, kind == 0 ? "train(s)" : "user(s)");
+    }
+    if ((!trainImport.empty() || !userImport.empty()) && servePort < 0 && !batch) {
+        return 0;
+    }
+    app.bookingAdmission().setLimits(admissionLimits);
+    if (servePort >= 0) {
+#if defined(__linux__)
+        return NetworkServer(app, servePort, benchConfig.threads).serve();
+#else
+        std::cerr << "❌ --serve is only available on Linux." << std::endl;
+        return 1;
+#endif
+    }
+    if (!batch) {
+        app.run();
+        return 0;
+    }
+
+    std::ifstream file;
+    if (!batchFile.empty()) {
+        file.open(batchFile);
+        if (!file) {
+            std::cerr << "❌ Cannot open " << batchFile << std::endl;
+            return 1;
+        }
+    }
+    std::ios::sync_with_stdio(false);
+    auto start = std::chrono::steady_clock::now();
+    std::size_t commands = BatchRunner(app).run(batchFile.empty() ? std::cin : file, std::cout);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << commands << " commands in " << std::fixed << std::setprecision(3) << seconds << " s ("
+              << std::setprecision(0) << (seconds > 0 ? commands / seconds : 0) << " commands/s)" << std::endl;
     return 0;
 }